@@ -0,0 +1,251 @@
+/*
+ * @file
+ * @brief Constant bandwidth server reservations of task threads.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include "switch_count.h"
+#include "cbs_server.h"
+
+/*
+ * Execution cycles of a thread from its runtime stats. The kernel accounts a
+ * thread when it is switched out, so the slice of the running thread, the
+ * interrupted one when called from an ISR, is added from the switch in cycle
+ * kept by the tracing hook.
+ */
+uint64_t threadExecutionCycles(struct k_thread *thread) {
+#ifdef CONFIG_THREAD_RUNTIME_STATS
+	k_thread_runtime_stats_t stats;
+
+	if (k_thread_runtime_stats_get(thread, &stats)) {
+		return 0;
+	}
+	return stats.execution_cycles + switchCountRunningCycles(thread);
+#else
+	ARG_UNUSED(thread);
+	return 0;
+#endif
+}
+
+/* The functions below run with the server lock held */
+
+/* Charges the execution since the last accounting to the budget */
+static void account(struct cbsServer *s) {
+	uint64_t now = threadExecutionCycles(s->tid);
+	uint32_t used = (uint32_t)(now - s->mark);
+
+	s->mark = now;
+	s->remaining = used < s->remaining ? s->remaining - used : 0;
+}
+
+/* The budget cannot run out before the thread has run for remaining cycles */
+static void armBudget(struct cbsServer *s) {
+	k_timer_start(&s->timer, K_TICKS(k_cyc_to_ticks_ceil32(s->remaining)), K_NO_WAIT);
+}
+
+static void setDeadline(struct cbsServer *s) {
+#ifdef CONFIG_SCHED_DEADLINE
+	if (s->edf) {
+		k_thread_deadline_set(s->tid, (int)(s->deadline - k_cycle_get_32()));
+	}
+#endif
+}
+
+static void refill(struct cbsServer *s) {
+	s->remaining = s->budget;
+	s->deadline += s->period;
+	s->mark = threadExecutionCycles(s->tid);
+}
+
+/*
+ * Budget exhausted: under EDF the server is refilled and its deadline
+ * postponed by one period, otherwise the thread is throttled until the
+ * server deadline. A deadline already passed refills it at once.
+ */
+static void exhaust(struct cbsServer *s) {
+	int32_t left = (int32_t)(s->deadline - k_cycle_get_32());
+
+	if (s->edf) {
+		refill(s);
+		s->postponeCount++;
+		setDeadline(s);
+		armBudget(s);
+		return;
+	}
+	s->throttled = true;
+	s->throttleCount++;
+	k_thread_priority_set(s->tid, CBS_THROTTLE_PRIORITY);
+	k_timer_start(&s->timer, K_TICKS(k_cyc_to_ticks_ceil32(left > 0 ? left : 0)), K_NO_WAIT);
+}
+
+/* Refill of a throttled server at its deadline */
+static void unthrottle(struct cbsServer *s) {
+	s->throttled = false;
+	refill(s);
+	/* The ceiling mutex restores the priority saved at the lock, so wait for the unlock */
+	if (s->inCritical) {
+		s->restorePending = true;
+	} else {
+		k_thread_priority_set(s->tid, s->priority);
+	}
+	if (s->busy) {
+		armBudget(s);
+	}
+}
+
+static void cbsTimerHandler(struct k_timer *timer) {
+	struct cbsServer *s = CONTAINER_OF(timer, struct cbsServer, timer);
+	k_spinlock_key_t key = k_spin_lock(&s->lock);
+
+	if (s->throttled) {
+		unthrottle(s);
+	} else if (s->busy) {
+		account(s);
+		if (s->remaining) {
+			/* The thread was preempted, the rest of the budget is left */
+			armBudget(s);
+		} else if (s->inCritical) {
+			s->exhaustPending = true;
+		} else {
+			exhaust(s);
+		}
+	}
+	k_spin_unlock(&s->lock, key);
+}
+
+/*
+ * @function cbsInit
+ *
+ * @brief Sets up the reservation of a thread for a run, budgetUs every
+ * 		  periodUs. A budget of zero leaves the thread unreserved and makes
+ * 		  every other cbs call a no-op.
+ */
+void cbsInit(struct cbsServer *s, k_tid_t tid, uint32_t budgetUs, uint32_t periodUs,
+			 int priority, bool edf) {
+	k_timer_init(&s->timer, cbsTimerHandler, NULL);
+	s->tid = tid;
+	s->edf = edf;
+	s->priority = priority;
+	s->budget = k_us_to_cyc_ceil32(budgetUs);
+	s->period = k_us_to_cyc_ceil32(periodUs);
+	s->remaining = 0;
+	s->deadline = k_cycle_get_32();
+	s->idleSince = s->deadline;
+	s->busy = false;
+	s->throttled = false;
+	s->inCritical = false;
+	s->exhaustPending = false;
+	s->restorePending = false;
+	s->postponeCount = 0;
+	s->throttleCount = 0;
+}
+
+/*
+ * @function cbsJobStart
+ *
+ * @brief Called by the thread when it starts the job released at release.
+ * 		  A job arriving at an idle server gets a fresh budget and deadline
+ * 		  release + T, unless the remaining budget fits within the bandwidth
+ * 		  up to the current deadline (the CBS arrival rule). A job queued
+ * 		  behind the previous one continues with its budget and deadline.
+ */
+void cbsJobStart(struct cbsServer *s, uint32_t release) {
+	k_spinlock_key_t key;
+
+	if (!s->budget) {
+		return;
+	}
+	key = k_spin_lock(&s->lock);
+	if (!s->throttled && (int32_t)(release - s->idleSince) >= 0) {
+		int32_t left = (int32_t)(s->deadline - release);
+
+		if (left <= 0 || (uint64_t)s->remaining * s->period >= (uint64_t)left * s->budget) {
+			s->remaining = s->budget;
+			s->deadline = release + s->period;
+		}
+	}
+	s->busy = true;
+	s->mark = threadExecutionCycles(s->tid);
+	setDeadline(s);
+	if (!s->throttled) {
+		armBudget(s);
+	}
+	k_spin_unlock(&s->lock, key);
+}
+
+/* Called by the thread when its job completes or is abandoned */
+void cbsJobEnd(struct cbsServer *s) {
+	k_spinlock_key_t key;
+
+	if (!s->budget) {
+		return;
+	}
+	key = k_spin_lock(&s->lock);
+	account(s);
+	s->busy = false;
+	s->idleSince = k_cycle_get_32();
+	/* A throttled server keeps its timer for the refill */
+	if (!s->throttled) {
+		k_timer_stop(&s->timer);
+	}
+	k_spin_unlock(&s->lock, key);
+}
+
+/*
+ * Changes the priority of the thread outside a critical section. While the
+ * server is throttled the new priority only takes effect at the refill.
+ */
+void cbsSetPriority(struct cbsServer *s, int priority) {
+	k_spinlock_key_t key;
+
+	if (!s->budget) {
+		k_thread_priority_set(s->tid, priority);
+		return;
+	}
+	key = k_spin_lock(&s->lock);
+	s->priority = priority;
+	if (!s->throttled) {
+		k_thread_priority_set(s->tid, priority);
+	}
+	k_spin_unlock(&s->lock, key);
+}
+
+/* Called by the thread before it locks a ceiling mutex */
+void cbsEnterCritical(struct cbsServer *s) {
+	k_spinlock_key_t key;
+
+	if (!s->budget) {
+		return;
+	}
+	key = k_spin_lock(&s->lock);
+	s->inCritical = true;
+	k_spin_unlock(&s->lock, key);
+}
+
+/* Called by the thread after it unlocked the mutex, runs the deferred budget actions */
+void cbsLeaveCritical(struct cbsServer *s) {
+	k_spinlock_key_t key;
+
+	if (!s->budget) {
+		return;
+	}
+	key = k_spin_lock(&s->lock);
+	s->inCritical = false;
+	if (s->restorePending) {
+		s->restorePending = false;
+		k_thread_priority_set(s->tid, s->priority);
+	}
+	if (s->exhaustPending) {
+		s->exhaustPending = false;
+		exhaust(s);
+	}
+	k_spin_unlock(&s->lock, key);
+}
+
+/* Called after the thread has exited, stops the timer of the run */
+void cbsStop(struct cbsServer *s) {
+	if (s->budget) {
+		k_timer_stop(&s->timer);
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef __CBS_SERVER_H__
+#define __CBS_SERVER_H__
+
+/*
+ * Constant bandwidth server reserving a budget Q every period T for the
+ * jobs of one task thread. The thread's execution consumes the budget and
+ * a timer detects its exhaustion. Under EDF the server is then refilled at
+ * once with its deadline postponed by T; under fixed priorities the thread
+ * is throttled to CBS_THROTTLE_PRIORITY until the server deadline refills
+ * it. Either way the task takes at most Q / T of its core from the others.
+ */
+
+#include <zephyr.h>
+
+#define CBS_THROTTLE_PRIORITY K_LOWEST_APPLICATION_THREAD_PRIO
+
+struct cbsServer {
+	struct k_timer timer;	// budget exhaustion, or the refill while throttled
+	struct k_spinlock lock;
+	k_tid_t tid;
+	bool edf;				// postpone the deadline instead of throttling
+	int priority;			// run priority restored by the refill
+	uint32_t budget;		// Q in cycles, 0 when the task has no reservation
+	uint32_t period;		// T in cycles
+	uint32_t remaining;		// budget left in cycles
+	uint32_t deadline;		// server deadline in cycles
+	uint64_t mark;			// execution cycles of the thread when last accounted
+	uint32_t idleSince;		// end of the last job served
+	bool busy;				// a job is being served
+	bool throttled;
+	/* Budget actions inside a critical section wait for its end */
+	bool inCritical;
+	bool exhaustPending;
+	bool restorePending;
+	/* Counters of the run */
+	uint32_t postponeCount;
+	uint32_t throttleCount;
+};
+
+uint64_t threadExecutionCycles(struct k_thread *thread);
+void cbsInit(struct cbsServer *s, k_tid_t tid, uint32_t budgetUs, uint32_t periodUs,
+			 int priority, bool edf);
+void cbsJobStart(struct cbsServer *s, uint32_t release);
+void cbsJobEnd(struct cbsServer *s);
+void cbsSetPriority(struct cbsServer *s, int priority);
+void cbsEnterCritical(struct cbsServer *s);
+void cbsLeaveCritical(struct cbsServer *s);
+void cbsStop(struct cbsServer *s);
+
+#endif // __CBS_SERVER_H__
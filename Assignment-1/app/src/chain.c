@@ -0,0 +1,267 @@
+/*
+ * @file
+ * @brief Cause-effect chains over lock-free channels, and the "chains" shell command.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include <stdio.h>
+#include <string.h>
+#include <shell/shell.h>
+#include "task_pool.h"
+#include "chain.h"
+
+/*
+ * Single producer / single consumer channel from one task of a chain to the
+ * next. Only the producer writes head and only the consumer writes tail. A
+ * full channel drops the new sample and counts it; the consumer only keeps
+ * the newest sample and counts the ones it skipped.
+ */
+struct channel {
+	struct chainSample buf[CHANNEL_SIZE];
+	atomic_t head;
+	atomic_t tail;
+	atomic_t dropped;
+	atomic_t skipped;
+};
+
+/* Sample acted on by the output task, and when */
+struct chainOutput {
+	struct chainSample sample;
+	uint32_t finish;
+};
+
+/* Running summary of one latency, in microseconds */
+struct chainSummary {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+};
+
+struct chainState {
+	bool active;								// every task of the chain is in the pool
+	struct channel channels[MAX_CHAIN_TASKS - 1];	// channel k links task k to task k + 1
+	struct chainSample held[MAX_CHAIN_TASKS];	// written only by the task at that position
+	uint32_t inputSeq;							// written only by the input task
+	/* Output ring, the output task produces and the shell consumes */
+	struct chainOutput out[CHAIN_RING_SIZE];
+	atomic_t head;
+	atomic_t tail;
+	atomic_t dropped;
+	/* Consumer side summaries */
+	struct chainSummary latency;	// output of a new input - input, first output only
+	struct chainSummary age;		// output - input, every output
+	uint32_t lastOrigin;
+	uint32_t empty;					// outputs before any input reached the end
+};
+
+static struct chainState chainStates[NUM_CHAINS];
+
+static void summaryReset(struct chainSummary *sum) {
+	memset(sum, 0, sizeof(*sum));
+	sum->min = UINT32_MAX;
+}
+
+static void summaryAdd(struct chainSummary *sum, uint32_t us) {
+	sum->count++;
+	sum->sum += us;
+	sum->min = MIN(sum->min, us);
+	sum->max = MAX(sum->max, us);
+}
+
+static void channelWrite(struct channel *ch, const struct chainSample *sample) {
+	atomic_val_t head = atomic_get(&ch->head);
+
+	if (head - atomic_get(&ch->tail) >= CHANNEL_SIZE) {
+		atomic_inc(&ch->dropped);
+		return;
+	}
+	ch->buf[head & (CHANNEL_SIZE - 1)] = *sample;
+	/* atomic_set is a full barrier: the sample is visible before the index */
+	atomic_set(&ch->head, head + 1);
+}
+
+/* Takes the newest sample of the channel, returns false when it is empty */
+static bool channelReadNewest(struct channel *ch, struct chainSample *sample) {
+	atomic_val_t head = atomic_get(&ch->head);
+	atomic_val_t tail = atomic_get(&ch->tail);
+
+	if (head == tail) {
+		return false;
+	}
+	/* The producer never writes the slot before head until tail moves past it */
+	*sample = ch->buf[(head - 1) & (CHANNEL_SIZE - 1)];
+	atomic_add(&ch->skipped, head - tail - 1);
+	atomic_set(&ch->tail, head);
+	return true;
+}
+
+/* Position of a slot's task in a chain, -1 when it is not part of it */
+static int chainPosition(int chain, int taskNumber) {
+	if (!chainStates[chain].active || taskPoolModelIndex(taskNumber) < 0) {
+		return -1;
+	}
+	for (int p = 0; p < chains[chain].length; p++) {
+		if (chains[chain].tasks[p] == taskNumber) {
+			return p;
+		}
+	}
+	return -1;
+}
+
+/*
+ * @function chainInit
+ *
+ * @brief Empties the channels, output rings and summaries before a run. A
+ * 		  chain is only active when all its tasks are in the pool; the pool
+ * 		  slot of a task_model.h task is its index in threads[].
+ */
+void chainInit(void) {
+	memset(chainStates, 0, sizeof(chainStates));
+	for (int c = 0; c < NUM_CHAINS; c++) {
+		struct chainState *state = &chainStates[c];
+
+		state->active = true;
+		for (int p = 0; p < chains[c].length; p++) {
+			if (taskPoolModelIndex(chains[c].tasks[p]) < 0) {
+				state->active = false;
+			}
+		}
+		summaryReset(&state->latency);
+		summaryReset(&state->age);
+	}
+}
+
+/*
+ * @function chainJobStart
+ *
+ * @brief Called by a task when a job starts. The input task of a chain
+ * 		  takes a new input stamped with the start of the job; every other
+ * 		  task reads the newest sample of the task before it, or keeps the
+ * 		  one of its previous job when nothing new has arrived.
+ */
+void chainJobStart(int taskNumber, uint32_t start) {
+	for (int c = 0; c < NUM_CHAINS; c++) {
+		struct chainState *state = &chainStates[c];
+		int p = chainPosition(c, taskNumber);
+
+		if (p == 0) {
+			state->held[0].origin = ++state->inputSeq;
+			state->held[0].stamp = start;
+		} else if (p > 0) {
+			channelReadNewest(&state->channels[p - 1], &state->held[p]);
+		}
+	}
+}
+
+/*
+ * @function chainJobEnd
+ *
+ * @brief Called by a task when a job completes. Every task but the output
+ * 		  one passes the sample it worked on to the next task; the output
+ * 		  task logs it with the completion time. Aborted jobs pass nothing.
+ */
+void chainJobEnd(int taskNumber, uint32_t finish) {
+	for (int c = 0; c < NUM_CHAINS; c++) {
+		struct chainState *state = &chainStates[c];
+		int p = chainPosition(c, taskNumber);
+		atomic_val_t head;
+
+		if (p < 0 || !state->held[p].origin) {
+			if (p == chains[c].length - 1) {
+				state->empty++;
+			}
+			continue;
+		}
+		if (p < chains[c].length - 1) {
+			channelWrite(&state->channels[p], &state->held[p]);
+			continue;
+		}
+		head = atomic_get(&state->head);
+		if (head - atomic_get(&state->tail) >= CHAIN_RING_SIZE) {
+			atomic_inc(&state->dropped);
+			continue;
+		}
+		state->out[head & (CHAIN_RING_SIZE - 1)].sample = state->held[p];
+		state->out[head & (CHAIN_RING_SIZE - 1)].finish = finish;
+		atomic_set(&state->head, head + 1);
+	}
+}
+
+/*
+ * @function chainCollect
+ *
+ * @brief Drains the output rings into the summaries. The data age of an
+ * 		  output is its completion minus the time its input was taken. The
+ * 		  end-to-end latency is the same difference for the first output
+ * 		  that acts on a given input, i.e. the reaction to that input. Only
+ * 		  the shell thread consumes the rings.
+ */
+void chainCollect(void) {
+	for (int c = 0; c < NUM_CHAINS; c++) {
+		struct chainState *state = &chainStates[c];
+		atomic_val_t tail = atomic_get(&state->tail);
+		atomic_val_t head = atomic_get(&state->head);
+
+		while (tail != head) {
+			const struct chainOutput *out = &state->out[tail & (CHAIN_RING_SIZE - 1)];
+			uint32_t us = k_cyc_to_us_floor32(out->finish - out->sample.stamp);
+
+			summaryAdd(&state->age, us);
+			if (out->sample.origin != state->lastOrigin) {
+				summaryAdd(&state->latency, us);
+				state->lastOrigin = out->sample.origin;
+			}
+			tail++;
+		}
+		atomic_set(&state->tail, tail);
+	}
+}
+
+static void printSummary(const struct shell *shell, const char *label,
+						 const struct chainSummary *sum) {
+	if (!sum->count) {
+		shell_print(shell, "  %-9s no outputs", label);
+		return;
+	}
+	shell_print(shell, "  %-9s min %u mean %u max %u us", label, sum->min,
+				(uint32_t)(sum->sum / sum->count), sum->max);
+}
+
+/*
+ * This is the entry point function for the root shell command "chains".
+ */
+static int chainsCommand(const struct shell *shell, size_t argc, char **argv) {
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	chainCollect();
+	for (int c = 0; c < NUM_CHAINS; c++) {
+		const struct chainState *state = &chainStates[c];
+		char path[MAX_CHAIN_TASKS * 36];
+		int len = 0;
+
+		for (int p = 0; p < chains[c].length; p++) {
+			len += snprintf(&path[len], sizeof(path) - len, "%s%s", p ? " -> " : "",
+							threads[chains[c].tasks[p]].t_name);
+		}
+		if (!state->active) {
+			shell_print(shell, "%s: %s, inactive, a task is not in the pool", chains[c].c_name, path);
+			continue;
+		}
+		shell_print(shell, "%s: %s, %u inputs, %u outputs of %u inputs, %u without input, "
+					"%u dropped", chains[c].c_name, path, state->inputSeq, state->age.count,
+					state->latency.count, state->empty, (uint32_t)atomic_get(&state->dropped));
+		printSummary(shell, "latency", &state->latency);
+		printSummary(shell, "data age", &state->age);
+		for (int p = 0; p < chains[c].length - 1; p++) {
+			shell_print(shell, "  %s -> %s: %u samples dropped, %u overwritten",
+						threads[chains[c].tasks[p]].t_name, threads[chains[c].tasks[p + 1]].t_name,
+						(uint32_t)atomic_get(&state->channels[p].dropped),
+						(uint32_t)atomic_get(&state->channels[p].skipped));
+		}
+	}
+	return 0;
+}
+SHELL_CMD_REGISTER(chains, NULL, "End-to-end latency and data age of the cause-effect chains",
+				   chainsCommand);
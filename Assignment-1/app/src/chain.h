@@ -0,0 +1,27 @@
+#ifndef __CHAIN_H__
+#define __CHAIN_H__
+
+/*
+ * Cause-effect chains of task_model.h. Consecutive tasks of a chain are
+ * linked by wait-free single producer / single consumer channels. Every
+ * sample carries the time at which the input task of the chain took it;
+ * the output task logs the samples it acts on into a ring that the shell
+ * "chains" command drains into end-to-end latency and data age figures.
+ */
+
+#include <zephyr.h>
+
+#define CHANNEL_SIZE 8			// samples per channel, must be a power of two
+#define CHAIN_RING_SIZE 128		// output records per chain, must be a power of two
+
+struct chainSample {
+	uint32_t origin;	// sequence number of the chain input, 0 before the first one
+	uint32_t stamp;		// cycle at which the input was taken
+};
+
+void chainInit(void);
+void chainJobStart(int taskNumber, uint32_t start);
+void chainJobEnd(int taskNumber, uint32_t finish);
+void chainCollect(void);
+
+#endif // __CHAIN_H__
@@ -0,0 +1,164 @@
+/*
+ * @file
+ * @brief Table driven cyclic executive of the task_model.h set.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <string.h>
+#include "task_model.h"
+#include "cyclic_table.h"
+#include "workload.h"
+#include "job_stats.h"
+#include "cyclic_exec.h"
+
+static struct k_timer frameTimer;
+
+/* Per task state of the executive, indexed like threads[] */
+struct cyclicTask {
+	struct jobRecord job;	// job in progress
+	uint32_t periodCycles;
+	uint32_t droppedSeq;	// last job dropped in a skipped frame
+	uint32_t jobs;
+	uint32_t misses;
+	uint32_t dropped;
+};
+
+static struct cyclicTask cyclicTasks[NUM_THREADS];
+
+/*
+ * Sequence number of the job of a task that frame slot n of the run holds.
+ * Every segment of a job lies between its release and its deadline, one
+ * period later, so the job is the last one released at the frame start.
+ */
+static uint32_t slotJob(int task, uint32_t n) {
+	return (uint32_t)((uint64_t)n * cyclicFrameUs /
+					  ((uint64_t)threads[task].period * USEC_PER_MSEC)) + 1;
+}
+
+/* Start tick of frame slot n, from the origin of the run so that it never drifts */
+static int64_t slotTick(int64_t originTick, uint32_t n) {
+	return originTick + (int64_t)k_us_to_ticks_ceil64((uint64_t)n * cyclicFrameUs);
+}
+
+/* Drops the jobs that have a segment in a skipped frame slot */
+static void skipSlot(uint32_t n) {
+	uint32_t j = n % cyclicFrameCount;
+
+	for (uint32_t e = cyclicFrameStart[j]; e < cyclicFrameStart[j + 1]; e++) {
+		struct cyclicTask *task = &cyclicTasks[cyclicEntries[e].task];
+		uint32_t seq = slotJob(cyclicEntries[e].task, n);
+
+		if (task->droppedSeq != seq) {
+			task->droppedSeq = seq;
+			task->dropped++;
+		}
+	}
+}
+
+/* Runs one segment of the table, recording the job it belongs to */
+static void runSegment(const struct cyclicEntry *entry, uint32_t epoch, uint32_t n) {
+	struct cyclicTask *task = &cyclicTasks[entry->task];
+	const struct task_s *taskInfo = &threads[entry->task];
+	struct jobRecord *job = &task->job;
+	uint32_t seq = slotJob(entry->task, n);
+
+	/* The rest of a job dropped in a skipped frame is not run */
+	if (seq == task->droppedSeq) {
+		return;
+	}
+	switch (entry->segment) {
+	case 0:
+		job->seq = seq;
+		job->release = epoch +
+			(uint32_t)k_ms_to_cyc_floor64((uint64_t)(job->seq - 1) * taskInfo->period);
+		job->start = k_cycle_get_32();
+		job->blocked = 0;
+		computeSegment(entry->task, 0, taskInfo->exec_us[0]);
+		break;
+	case 1:
+		/* No other segment can run inside this one, so no mutex is needed */
+		job->request = k_cycle_get_32();
+		job->locked = job->request;
+		computeSegment(entry->task, 1, taskInfo->exec_us[1]);
+		job->unlocked = k_cycle_get_32();
+		break;
+	default:
+		computeSegment(entry->task, 2, taskInfo->exec_us[2]);
+		job->finish = k_cycle_get_32();
+		job->lateness = (int32_t)(job->finish - (job->release + task->periodCycles));
+		jobStatsRecord(entry->task, job);
+		task->jobs++;
+		if (job->lateness > 0) {
+			task->misses++;
+		}
+		break;
+	}
+}
+
+/*
+ * @function cyclicRun
+ *
+ * @brief Runs the frame table for durationMs from the calling thread, raised
+ * 		  to CYCLIC_PRIORITY. Frame slot n of the run starts n frame lengths
+ * 		  after the origin of the run and runs the segments of table frame n
+ * 		  modulo the frame count back to back. A frame that is still running
+ * 		  when the next one is due is counted as an overrun, and the slots
+ * 		  whose start has passed are skipped, dropping the jobs they hold,
+ * 		  so that the schedule stays aligned with the origin. Job latencies
+ * 		  go to job_stats.c like those of the threaded mode, so "stats"
+ * 		  compares the two.
+ */
+void cyclicRun(const struct shell *shell, uint32_t durationMs) {
+	k_tid_t self = k_current_get();
+	int saved = k_thread_priority_get(self);
+	uint32_t frames = durationMs * USEC_PER_MSEC / cyclicFrameUs;
+	uint32_t overruns = 0;
+	uint32_t skipped = 0;
+	uint32_t epoch;
+	int64_t originTick;
+
+	workloadReset();
+	for (int i = 0; i < NUM_THREADS; i++) {
+		workloadPrepare(i, &threads[i]);
+		memset(&cyclicTasks[i], 0, sizeof(cyclicTasks[i]));
+		cyclicTasks[i].periodCycles = k_ms_to_cyc_ceil32(threads[i].period);
+		jobStatsInit(i, threads[i].period * USEC_PER_MSEC);
+	}
+	k_thread_priority_set(self, CYCLIC_PRIORITY);
+	k_timer_init(&frameTimer, NULL, NULL);
+	/* Frame 0 starts now, the timer marks the start of every later frame */
+	originTick = k_uptime_ticks();
+	epoch = k_cycle_get_32();
+	for (uint32_t n = 0; n < frames;) {
+		uint32_t j = n % cyclicFrameCount;
+		int64_t now;
+
+		for (uint32_t e = cyclicFrameStart[j]; e < cyclicFrameStart[j + 1]; e++) {
+			runSegment(&cyclicEntries[e], epoch, n);
+		}
+		n++;
+		now = k_uptime_ticks();
+		if (slotTick(originTick, n) < now) {
+			overruns++;
+			while (n < frames && slotTick(originTick, n) < now) {
+				skipSlot(n++);
+				skipped++;
+			}
+		}
+		if (n < frames) {
+			k_timer_start(&frameTimer, K_TIMEOUT_ABS_TICKS(slotTick(originTick, n)), K_NO_WAIT);
+			k_timer_status_sync(&frameTimer);
+		}
+	}
+	k_thread_priority_set(self, saved);
+
+	for (int i = 0; i < NUM_THREADS; i++) {
+		shell_print(shell, "[CE] %s: %u jobs, %u deadline misses, %u dropped",
+					threads[i].t_name, cyclicTasks[i].jobs, cyclicTasks[i].misses,
+					cyclicTasks[i].dropped);
+	}
+	shell_print(shell, "[CE] %u frames of %u us, %u overruns, %u frames skipped, table of %u frames",
+				frames, cyclicFrameUs, overruns, skipped, cyclicFrameCount);
+}
@@ -0,0 +1,18 @@
+#ifndef __CYCLIC_EXEC_H__
+#define __CYCLIC_EXEC_H__
+
+/*
+ * Cyclic executive run mode. Instead of one thread per task, a single
+ * thread driven by a periodic frame timer runs the compute segments of the
+ * task_model.h set in the order of the generated frame table, with no
+ * context switch between tasks and no mutex.
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+
+#define CYCLIC_PRIORITY 0	// priority of the executive while it runs
+
+void cyclicRun(const struct shell *shell, uint32_t durationMs);
+
+#endif // __CYCLIC_EXEC_H__
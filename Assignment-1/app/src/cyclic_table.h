@@ -0,0 +1,24 @@
+#ifndef __CYCLIC_TABLE_H__
+#define __CYCLIC_TABLE_H__
+
+/*
+ * Frame table of the cyclic executive. It is generated on the host from
+ * task_model.h by tools/cyclic_gen.c into the build directory, so this
+ * header must not depend on any Zephyr header.
+ */
+
+#include <stdint.h>
+
+/* One compute segment of a job of task_model.h task */
+struct cyclicEntry {
+	uint8_t task;		// index into threads[]
+	uint8_t segment;	// 0, 1 (the critical section) or 2
+};
+
+extern const uint32_t cyclicFrameUs;		// frame length
+extern const uint32_t cyclicFrameCount;		// frames in the hyperperiod
+/* Frame j runs cyclicEntries[cyclicFrameStart[j]] up to cyclicFrameStart[j + 1] */
+extern const uint16_t cyclicFrameStart[];
+extern const struct cyclicEntry cyclicEntries[];
+
+#endif // __CYCLIC_TABLE_H__
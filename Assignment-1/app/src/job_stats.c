@@ -0,0 +1,166 @@
+/*
+ * @file
+ * @brief Lock-free per-job latency recorder and the "stats" shell command.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <shell/shell.h>
+#include "task_pool.h"
+#include "job_stats.h"
+
+/*
+ * Single producer (the task thread) / single consumer (the shell thread)
+ * ring. Only the producer writes head and only the consumer writes tail, so
+ * no lock is needed; a full ring drops the record and counts it.
+ */
+struct jobRing {
+	struct jobRecord rec[JOB_RING_SIZE];
+	atomic_t head;
+	atomic_t tail;
+	atomic_t dropped;
+};
+
+/* Running summary of one latency, in microseconds */
+struct latencySummary {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+	uint32_t width;		// histogram bucket width
+	uint32_t bucket[LATENCY_BUCKETS];
+};
+
+struct taskStats {
+	struct latencySummary response;	// finish - release
+	struct latencySummary jitter;	// start - release
+	uint32_t late;					// jobs finished after their deadline
+	int32_t worstLateness;			// in microseconds
+};
+
+static struct jobRing jobRings[MAX_TASKS];
+static struct taskStats taskStats[MAX_TASKS];
+
+static void latencyReset(struct latencySummary *lat, uint32_t width) {
+	memset(lat, 0, sizeof(*lat));
+	lat->min = UINT32_MAX;
+	lat->width = width ? width : 1;
+}
+
+static void latencyAdd(struct latencySummary *lat, uint32_t us) {
+	uint32_t b = us / lat->width;
+
+	lat->count++;
+	lat->sum += us;
+	lat->min = MIN(lat->min, us);
+	lat->max = MAX(lat->max, us);
+	lat->bucket[MIN(b, LATENCY_BUCKETS - 1)]++;
+}
+
+/* Upper edge of the bucket holding the given percentile, bounded by max */
+static uint32_t latencyPercentile(const struct latencySummary *lat, uint32_t percent) {
+	uint32_t rank = (lat->count * percent + 99) / 100;
+	uint32_t seen = 0;
+
+	for (int b = 0; b < LATENCY_BUCKETS - 1; b++) {
+		seen += lat->bucket[b];
+		if (seen >= rank) {
+			return MIN((b + 1) * lat->width, lat->max);
+		}
+	}
+	return lat->max;
+}
+
+/*
+ * @function jobStatsInit
+ *
+ * @brief Empties the ring and the summaries of a task. Histogram buckets are
+ * 		  scaled to the period: response times up to two periods and release
+ * 		  jitter up to an eighth of a period are resolved.
+ */
+void jobStatsInit(int taskNumber, uint32_t periodUs) {
+	atomic_set(&jobRings[taskNumber].head, 0);
+	atomic_set(&jobRings[taskNumber].tail, 0);
+	atomic_set(&jobRings[taskNumber].dropped, 0);
+	latencyReset(&taskStats[taskNumber].response, 2 * periodUs / LATENCY_BUCKETS);
+	latencyReset(&taskStats[taskNumber].jitter, periodUs / 8 / LATENCY_BUCKETS);
+	taskStats[taskNumber].late = 0;
+	taskStats[taskNumber].worstLateness = INT32_MIN;
+}
+
+/* Called by the task itself at the end of every job */
+void jobStatsRecord(int taskNumber, const struct jobRecord *job) {
+	struct jobRing *ring = &jobRings[taskNumber];
+	atomic_val_t head = atomic_get(&ring->head);
+
+	if (head - atomic_get(&ring->tail) >= JOB_RING_SIZE) {
+		atomic_inc(&ring->dropped);
+		return;
+	}
+	ring->rec[head & (JOB_RING_SIZE - 1)] = *job;
+	/* atomic_set is a full barrier: the record is visible before the index */
+	atomic_set(&ring->head, head + 1);
+}
+
+/*
+ * @function jobStatsCollect
+ *
+ * @brief Drains every ring into the per-task summaries. Only the shell
+ * 		  thread consumes the rings.
+ */
+void jobStatsCollect(void) {
+	for (int i = 0; i < MAX_TASKS; i++) {
+		struct jobRing *ring = &jobRings[i];
+		struct taskStats *stats = &taskStats[i];
+		atomic_val_t tail = atomic_get(&ring->tail);
+		atomic_val_t head = atomic_get(&ring->head);
+
+		while (tail != head) {
+			const struct jobRecord *job = &ring->rec[tail & (JOB_RING_SIZE - 1)];
+			int32_t lateness = job->lateness < 0 ?
+				-(int32_t)k_cyc_to_us_floor32(-job->lateness) :
+				(int32_t)k_cyc_to_us_floor32(job->lateness);
+
+			latencyAdd(&stats->response, k_cyc_to_us_floor32(job->finish - job->release));
+			latencyAdd(&stats->jitter, k_cyc_to_us_floor32(job->start - job->release));
+			if (lateness > 0) {
+				stats->late++;
+			}
+			stats->worstLateness = MAX(stats->worstLateness, lateness);
+			tail++;
+		}
+		atomic_set(&ring->tail, tail);
+	}
+}
+
+static void printLatency(const struct shell *shell, const char *label,
+						 const struct latencySummary *lat) {
+	if (!lat->count) {
+		shell_print(shell, "  %-9s no jobs", label);
+		return;
+	}
+	shell_print(shell, "  %-9s min %u mean %u p99 %u max %u us", label, lat->min,
+				(uint32_t)(lat->sum / lat->count), latencyPercentile(lat, 99), lat->max);
+}
+
+/*
+ * This is the entry point function for the root shell command "stats".
+ */
+static int statsCommand(const struct shell *shell, size_t argc, char **argv) {
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	jobStatsCollect();
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		const struct taskStats *stats = &taskStats[i];
+
+		shell_print(shell, "%s: %u jobs, %u late, worst lateness %d us, %u dropped",
+					taskPoolGet(i)->t_name, stats->response.count, stats->late,
+					stats->response.count ? stats->worstLateness : 0,
+					(uint32_t)atomic_get(&jobRings[i].dropped));
+		printLatency(shell, "response", &stats->response);
+		printLatency(shell, "jitter", &stats->jitter);
+	}
+	return 0;
+}
+SHELL_CMD_REGISTER(stats, NULL, "Per task response time and release jitter", statsCommand);
@@ -0,0 +1,32 @@
+#ifndef __JOB_STATS_H__
+#define __JOB_STATS_H__
+
+/*
+ * Per-job latency recorder. Every task thread pushes one jobRecord per job
+ * into its own single producer / single consumer ring; the shell "stats"
+ * command drains the rings and reports response time and release jitter.
+ */
+
+#include <zephyr.h>
+
+#define JOB_RING_SIZE 256	// records per task, must be a power of two
+#define LATENCY_BUCKETS 128	// histogram buckets per latency summary
+
+/* Timestamps are hardware cycles (k_cycle_get_32) */
+struct jobRecord {
+	uint32_t seq;		// job sequence number, the first job is 1
+	uint32_t release;	// nominal release of the job
+	uint32_t start;		// job started executing
+	uint32_t blocked;	// cycles a lower priority critical section delayed the start
+	uint32_t request;	// mutex_m requested
+	uint32_t locked;	// mutex_m acquired
+	uint32_t unlocked;	// mutex_m released
+	uint32_t finish;	// job completed
+	int32_t lateness;	// finish - absolute deadline, negative when early
+};
+
+void jobStatsInit(int taskNumber, uint32_t periodUs);
+void jobStatsRecord(int taskNumber, const struct jobRecord *job);
+void jobStatsCollect(void);
+
+#endif // __JOB_STATS_H__
@@ -18,39 +18,132 @@
 #include <version.h>
 #include <logging/log.h>
 #include <stdio.h>
-#include "task_model.h"
+#include <stdlib.h>
+#include <string.h>
+#include "task_pool.h"
+#include "job_stats.h"
+#include "sched_analysis.h"
+#include "workload.h"
+#include "trace_log.h"
+#include "pcp_mutex.h"
+#include "wcet.h"
+#include "stack_table.h"
+#include "stack_profile.h"
+#include "cyclic_exec.h"
+#include "cbs_server.h"
+#include "switch_count.h"
+#include "chain.h"
+#include "task_gen.h"
+#ifdef CONFIG_APP_BENCHMARK_AUTORUN
+#include <shell/shell_uart.h>
+#endif
 
 /* Registering with the logger module*/
 LOG_MODULE_REGISTER(app);
 
-/* Initialising the stacks for the specified number of threads */
-#define STACKSIZE 1024
-K_THREAD_STACK_ARRAY_DEFINE(threadStackGlobal, NUM_THREADS, STACKSIZE);
+/*
+ * Thread and stack pool, one of each per slot of the runtime task set. The
+ * slots of the task_model.h tasks get their own stack size from
+ * stack_table.h, the spare slots share one.
+ */
+K_THREAD_STACK_DEFINE(taskStack0, TASK0_STACK_SIZE);
+K_THREAD_STACK_DEFINE(taskStack1, TASK1_STACK_SIZE);
+K_THREAD_STACK_DEFINE(taskStack2, TASK2_STACK_SIZE);
+K_THREAD_STACK_DEFINE(taskStack3, TASK3_STACK_SIZE);
+K_THREAD_STACK_ARRAY_DEFINE(spareStacks, MAX_TASKS - NUM_THREADS, SPARE_STACK_SIZE);
+
+/* Cores the task set is partitioned over, and admission tested on */
+#ifdef CONFIG_APP_SMP_PARTITIONED
+#define PARTITION_CPUS CONFIG_MP_NUM_CPUS
+#else
+#define PARTITION_CPUS 1
+#endif
+
+/*
+ * Releases of a LO task kept in HI criticality mode: none when 0, every nth
+ * otherwise.
+ */
+#ifdef CONFIG_APP_MIXED_CRITICALITY
+#define MC_DEGRADE_FACTOR CONFIG_APP_MC_DEGRADE_FACTOR
+#else
+#define MC_DEGRADE_FACTOR 0
+#endif
+
+/* Released jobs waiting for their task, beyond these a release is skipped */
+#define RELEASE_QUEUE_DEPTH 4
+/* Sequence number queued to stop a task thread */
+#define JOB_EXIT 0
+/* Percent added to the execution time of a task added at runtime for its budget */
+#define BUDGET_MARGIN 5
 
 /*
  * Defining the cutom datastructures.
  */
 struct threadTimerData {
-	int64_t timestamp;
 	k_tid_t tid;
 	int taskNumber;
-	atomic_t taskCompleted;
+	int cpu;					// core the task is pinned to
+	size_t stackSize;			// size of the stack the thread runs on
+	uint32_t periodCycles;
+	int64_t periodTicks;
+	int64_t nextRelease;		// absolute tick of the next release
+	uint32_t releaseSeq;		// sequence number of the last release
+	uint32_t queuedSeq;			// last job handed to the task
+	struct k_msgq releaseQueue;	// sequence numbers of the released jobs
+	uint32_t releaseBuffer[RELEASE_QUEUE_DEPTH];
+	atomic_t completedSeq;		// last job finished or aborted by the task
+	atomic_t abortSeq;			// jobs up to this one are to be abandoned
+	bool inMode;				// the task is released in the current mode
+	int64_t originTick;			// absolute tick at which job 1 is or would be released
+	atomic_t lastSeq;			// jobs after this one are dropped, set when retired
+	uint32_t budgetCycles[2];	// execution budget per job in LO and in HI mode
+	uint64_t jobStartCycles;	// execution cycles of the thread when the job started
+	atomic_t jobCount;
+	atomic_t missCount;
+	atomic_t skipCount;
+	atomic_t abortCount;
+	atomic_t budgetCount;		// jobs stopped at their budget
+	atomic_t critDropCount;		// releases dropped in HI mode
+	struct cbsServer server;	// reservation of the task, if it has one
 };
 
 struct globalTimerData {
-	k_tid_t spawnedTids[NUM_THREADS];
+	k_tid_t spawnedTids[MAX_TASKS];
 	atomic_t exitFlag;
 	const struct shell *shell; 
+	enum schedPolicy policy;
+	int64_t epochTick;			// common epoch of all releases
+	uint32_t epochCycle;		// cycle counter at the first release
+	int64_t nextDispatch;		// absolute tick of the next dispatcher expiry
+	uint32_t dispatchCount;		// dispatcher timer expiries
+	bool measureWcet;			// jobs report their segment times to wcet.c
+	atomic_t running;			// a task set is active
+	int mode;					// current mode, index into modes[]
+	atomic_t pendingMode;		// mode change requested, -1 when none
+	bool retiring;				// a mode change waits for retired jobs
+	uint32_t modeChanges;		// mode changes completed in this run
+	bool cyclic;				// this run uses the cyclic executive instead of threads
+	atomic_t critMode;			// CRIT_LO or CRIT_HI
+	atomic_t pendingJobs;		// jobs released and not yet ended
+	atomic_t critSwitches;		// switches to HI mode in this run
+	bool useThresholds;			// started jobs run at their preemption threshold under RM
+	uint32_t runMs;				// length of a run of the task threads
+	bool quiet;					// no per task output, the benchmark prints its own
 };
 
 /*
  * Initialising the global datastructures.
  */
-struct k_mutex mutex[NUM_MUTEXES];
-struct k_thread threadStruct[NUM_THREADS];
-struct threadTimerData threadSpecificData[NUM_THREADS];
-struct globalTimerData gThreadData;
-struct k_timer threadDeadlineTimers[NUM_THREADS]; 
+struct ceilingMutex mutex[NUM_MUTEXES];
+struct k_thread threadStruct[MAX_TASKS];
+struct threadTimerData threadSpecificData[MAX_TASKS];
+struct globalTimerData gThreadData = {
+	.policy = IS_ENABLED(CONFIG_APP_SCHED_EDF) ? POLICY_EDF : POLICY_RM,
+	.pendingMode = ATOMIC_INIT(-1),
+	.useThresholds = true,
+	.runMs = TOTAL_TIME,
+};
+struct k_timer releaseTimer;
 struct k_timer exitTimer;
 
 
@@ -58,35 +151,550 @@ struct k_timer exitTimer;
  * Forward declarations of member functions.
  */
 void threadExitHandler(struct k_timer *timer);
-void threadDeadlineHandler(struct k_timer *timer);
+void releaseHandler(struct k_timer *timer);
 void launchTask(int taskNumber);
-void threadFunction(struct task_s *taskInfo, int taskNumber, void* dummy);
+void threadFunction(const struct task_s *taskInfo, int taskNumber, void* dummy);
 void initTimerData(int taskNumber);
+void initMutexes(void);
+void partitionTasks(void);
 void taskDispatcher(void);
+void printMissSummary(void);
+int getRunPriority(int taskNumber);
+void runnerThread(void);
+
+/* Stack of the thread that runs the task set for the shell */
+#define RUNNER_STACKSIZE 2048
+K_SEM_DEFINE(runStart, 0, 1);
+K_SEM_DEFINE(runDone, 0, 1);
+K_THREAD_DEFINE(runner, RUNNER_STACKSIZE, runnerThread, NULL, NULL, NULL,
+				K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+
+/*
+ * @function startRun
+ *
+ * @brief Hands the task set to the runner thread and returns, so the shell
+ * 		  stays usable while the set runs, in particular for "mode". runDone
+ * 		  is given when the run is over.
+ */
+int startRun(const struct shell *shell) {
+	if (!taskPoolCount() || !taskPoolModeSlots(gThreadData.mode)) {
+		shell_error(shell, "no task runs in mode %s", modes[gThreadData.mode].m_name);
+		return -ENOEXEC;
+	}
+	if (!atomic_cas(&gThreadData.running, 0, 1)) {
+		shell_error(shell, "a task set is already running");
+		return -EBUSY;
+	}
+	gThreadData.shell = shell;
+	k_sem_reset(&runDone);
+	k_sem_give(&runStart);
+	return 0;
+}
+
+/* Rejects the shell commands that must not run while a task set is active */
+bool isRunning(const struct shell *shell) {
+	if (atomic_get(&gThreadData.running)) {
+		shell_error(shell, "not while a task set is running");
+		return true;
+	}
+	return false;
+}
 
 /*
  * This is the entry point function for the root shell command "activate".  
+ * An optional argument selects the scheduling policy of this run: "rm" for
+ * the fixed task_s priorities or "edf" for earliest deadline first. "cyclic"
+ * runs the task_model.h set once under the table driven cyclic executive.
  */
 
 int activate(const struct shell *shell, size_t argc, char **argv) {
-    ARG_UNUSED(argc);
+	if (isRunning(shell)) {
+		return -EBUSY;
+	}
+	gThreadData.cyclic = false;
+	if (argc > 1) {
+		if (!strcmp(argv[1], "cyclic") && IS_ENABLED(CONFIG_APP_CYCLIC_EXECUTIVE)) {
+			gThreadData.cyclic = true;
+		} else if (!strcmp(argv[1], "rm")) {
+			gThreadData.policy = POLICY_RM;
+		} else if (!strcmp(argv[1], "edf") && IS_ENABLED(CONFIG_SCHED_DEADLINE)) {
+			gThreadData.policy = POLICY_EDF;
+		} else {
+			shell_error(shell, "unknown or unsupported policy: %s", argv[1]);
+			return -EINVAL;
+		}
+	}
+    return startRun(shell);
+}
+SHELL_CMD_ARG_REGISTER(activate, NULL, "Activating all the threads [rm|edf|cyclic]", activate, 1, 1);
+
+/*
+ * This is the entry point function for the root shell command "wcet". Every
+ * task is run alone for the given number of jobs, then the whole set is run
+ * once under the current policy, and the measured segment times and blocking
+ * are printed as a replacement for src/wcet_table.h.
+ */
+int wcet(const struct shell *shell, size_t argc, char **argv) {
+	int jobs = argc > 1 ? atoi(argv[1]) : WCET_JOBS;
+
+	int ret;
+
+	if (isRunning(shell)) {
+		return -EBUSY;
+	}
+	if (jobs <= 0) {
+		shell_error(shell, "invalid number of jobs: %s", argv[1]);
+		return -EINVAL;
+	}
+	wcetReset();
+	workloadReset();
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		workloadPrepare(i, taskPoolGet(i));
+	}
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		shell_info(shell, "measuring %s alone over %d jobs", taskPoolGet(i)->t_name, jobs);
+		wcetMeasureAlone(i, getRunPriority(i), jobs);
+	}
+	shell_info(shell, "measuring the task set under contention");
+	gThreadData.measureWcet = true;
+	ret = startRun(shell);
+	if (!ret) {
+		k_sem_take(&runDone, K_FOREVER);
+	}
+	gThreadData.measureWcet = false;
+	if (ret) {
+		return ret;
+	}
+	wcetPrintTable(shell, jobs);
+	return 0;
+}
+SHELL_CMD_ARG_REGISTER(wcet, NULL, "Measure segment times and blocking [jobs]", wcet, 1, 1);
+
+#ifdef CONFIG_APP_BENCHMARK
+/*
+ * @function benchmark
+ *
+ * @brief Runs sets random task sets of CONFIG_APP_BENCHMARK_TASKS tasks at
+ * 		  every utilisation of the task_gen.h sweep, under every policy,
+ * 		  for one TASK_GEN_HYPERPERIOD each. Prints one comma separated line
+ * 		  per policy and utilisation: the sets run, the sets the analysis
+ * 		  accepts, the sets with a missed deadline or an aborted job, the
+ * 		  sets that could not be loaded and were not run, and the releases
+ * 		  and deadline misses of all of them. Every policy runs
+ * 		  the same sets, and the task pool is put back afterwards.
+ */
+void benchmark(const struct shell *shell, int sets, uint32_t seed) {
+	static struct taskPoolSnapshot saved;
+	static struct task_s tasks[MAX_TASKS];
+	static struct schedTask set[MAX_TASKS];
+	int slots[MAX_TASKS];
+	const enum schedPolicy policies[] = {POLICY_RM, POLICY_EDF};
+	int numPolicies = IS_ENABLED(CONFIG_SCHED_DEADLINE) ? 2 : 1;
+	enum schedPolicy policy = gThreadData.policy;
+	int n;
+
+	taskPoolSave(&saved);
+	gThreadData.quiet = true;
+	gThreadData.runMs = TASK_GEN_HYPERPERIOD;
+	traceLogMute(true);
+	shell_print(shell, "bench,policy,utilization,sets,accepted,failed,skipped,releases,misses,miss_ratio");
+	for (int p = 0; p < numPolicies; p++) {
+		for (int util = TASK_GEN_UTIL_MIN; util <= TASK_GEN_UTIL_MAX; util += TASK_GEN_UTIL_STEP) {
+			uint32_t releases = 0, misses = 0, ratio;
+			int accepted = 0, failed = 0, skipped = 0;
+
+			gThreadData.policy = policies[p];
+			taskGenSeed(seed ^ ((uint32_t)util << 16));
+			for (int k = 0; k < sets; k++) {
+				uint32_t setMisses = 0, setAborts = 0;
+
+				taskGenSet(CONFIG_APP_BENCHMARK_TASKS, util * (UTIL_ONE / 100), tasks);
+				if (taskPoolLoad(tasks, CONFIG_APP_BENCHMARK_TASKS)) {
+					/* Never run the pool left over from the previous set */
+					skipped++;
+					continue;
+				}
+				if (!taskPoolAnalyse(NULL, TASK_POOL_ALL, policies[p], PARTITION_CPUS, set, slots, &n)) {
+					accepted++;
+				}
+				if (startRun(shell)) {
+					break;
+				}
+				k_sem_take(&runDone, K_FOREVER);
+				for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+					releases += threadSpecificData[i].releaseSeq;
+					setMisses += atomic_get(&threadSpecificData[i].missCount);
+					setAborts += atomic_get(&threadSpecificData[i].abortCount);
+				}
+				misses += setMisses;
+				failed += setMisses || setAborts;
+			}
+			/* Deadline misses per release, in parts per ten thousand */
+			ratio = releases ? (uint64_t)misses * 10000U / releases : 0;
+			shell_print(shell, "bench,%s,%d.%02d,%d,%d,%d,%d,%u,%u,%u.%04u",
+						policies[p] == POLICY_EDF ? "EDF" : "RM", util / 100, util % 100, sets,
+						accepted, failed, skipped, releases, misses, ratio / 10000, ratio % 10000);
+		}
+	}
+	traceLogMute(false);
+	gThreadData.runMs = TOTAL_TIME;
+	gThreadData.quiet = false;
+	gThreadData.policy = policy;
+	taskPoolRestore(&saved);
+}
+
+/*
+ * This is the entry point function for the root shell command "bench". The
+ * optional arguments override the number of sets per point and the seed.
+ */
+int bench(const struct shell *shell, size_t argc, char **argv) {
+	int sets = argc > 1 ? atoi(argv[1]) : CONFIG_APP_BENCHMARK_SETS;
+	uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 0) : CONFIG_APP_BENCHMARK_SEED;
+
+	if (isRunning(shell)) {
+		return -EBUSY;
+	}
+	if (sets <= 0) {
+		shell_error(shell, "invalid number of sets: %s", argv[1]);
+		return -EINVAL;
+	}
+	benchmark(shell, sets, seed);
+	return 0;
+}
+SHELL_CMD_ARG_REGISTER(bench, NULL, "Miss ratio of random task sets per policy and "
+					   "utilisation [sets] [seed]", bench, 1, 2);
+#endif
+
+static const char *const overrunNames[] = {
+	[OVERRUN_CONTINUE] = "continue",
+	[OVERRUN_SKIP] = "skip",
+	[OVERRUN_ABORT] = "abort",
+};
+
+/* Prints the admission analysis of a task set, one line per task */
+void printAdmission(const struct shell *shell, const struct schedTask *set, int n) {
+	shell_print(shell, "  %-10s %3s %4s %8s %8s %8s %8s", "task", "cpu", "prio",
+				"C(us)", "B(us)", "R(us)", "D(us)");
+	for (int k = 0; k < n; k++) {
+		shell_print(shell, "  %-10s %3d %4d %8u %8u %8u %8u %s", set[k].name, set[k].cpu,
+					set[k].priority, set[k].wcet, set[k].blocking, set[k].response,
+					set[k].deadline, set[k].schedulable ? "ok" : "MISS");
+	}
+}
+
+/*
+ * Entry points of the "task" shell command, which lists, adds and removes
+ * periodic tasks between activations. The pool never changes under a
+ * running set; use "mode" to change the tasks of a running set.
+ */
+int taskList(const struct shell *shell, size_t argc, char **argv) {
+	struct schedTask set[MAX_TASKS];
+	int slots[MAX_TASKS];
+	int n;
+
+	ARG_UNUSED(argc);
 	ARG_UNUSED(argv);
-	gThreadData.shell = shell;
-    taskDispatcher();
-    return 0;
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		const struct task_s *task = taskPoolGet(i);
+		shell_print(shell, "slot %d: %s, priority %d, period %d ms, {%d, %d, %d} us, mutex %d, %s, "
+					"%s budget %d/%d us, reserve %d us, threshold %d, kernels %s/%s/%s over %d bytes",
+					i, task->t_name,
+					task->priority, task->period, task->exec_us[0], task->exec_us[1],
+					task->exec_us[2], task->mutex_m, overrunNames[task->overrun],
+					task->criticality == CRIT_HI ? "HI" : "LO", task->budget_us[CRIT_LO],
+					task->budget_us[CRIT_HI], task->reserve_us, task->threshold,
+					workloadKernelName(task->kernel[0]), workloadKernelName(task->kernel[1]),
+					workloadKernelName(task->kernel[2]), task->working_set);
+	}
+	shell_print(shell, "%d of %d slots used", taskPoolCount(), MAX_TASKS);
+	if (taskPoolAnalyse(NULL, TASK_POOL_ALL, gThreadData.policy, PARTITION_CPUS, set, slots, &n)) {
+		shell_warn(shell, "the task set can miss deadlines");
+	}
+	printAdmission(shell, set, n);
+	return 0;
+}
+
+/*
+ * task add <name> <priority> <period ms> <c1 us> <c2 us> <c3 us> <mutex>
+ * 			[continue|skip|abort] [reserve us] [kernel] [working set bytes]
+ */
+int taskAdd(const struct shell *shell, size_t argc, char **argv) {
+	struct schedTask set[MAX_TASKS + 1];
+	int slots[MAX_TASKS + 1];
+	struct task_s task = {0};
+	int n, slot;
+
+	if (isRunning(shell)) {
+		return -EBUSY;
+	}
+	strncpy(task.t_name, argv[1], sizeof(task.t_name) - 1);
+	task.priority = atoi(argv[2]);
+	task.period = atoi(argv[3]);
+	for (int k = 0; k < 3; k++) {
+		task.exec_us[k] = atoi(argv[4 + k]);
+	}
+	task.mutex_m = atoi(argv[7]);
+	task.threshold = task.priority;
+	/* Tasks added at runtime are LO tasks, budgeted a margin above their execution time */
+	task.criticality = CRIT_LO;
+	task.budget_us[CRIT_LO] = task.exec_us[0] + task.exec_us[1] + task.exec_us[2];
+	task.budget_us[CRIT_LO] += task.budget_us[CRIT_LO] * BUDGET_MARGIN / 100;
+	task.budget_us[CRIT_HI] = task.budget_us[CRIT_LO];
+	task.overrun = OVERRUN_CONTINUE;
+	if (argc > 8) {
+		task.overrun = -1;
+		for (int o = 0; o < ARRAY_SIZE(overrunNames); o++) {
+			if (!strcmp(argv[8], overrunNames[o])) {
+				task.overrun = o;
+			}
+		}
+	}
+	if (argc > 9) {
+		task.reserve_us = atoi(argv[9]);
+	}
+	/* One kernel for all three segments */
+	if (argc > 10) {
+		int kernel = workloadKernelFind(argv[10]);
+		for (int k = 0; k < 3; k++) {
+			task.kernel[k] = kernel;
+		}
+	}
+	if (argc > 11) {
+		task.working_set = atoi(argv[11]);
+	}
+	if (task.priority < 0 || task.priority > K_LOWEST_APPLICATION_THREAD_PRIO) {
+		shell_error(shell, "priority must be within 0..%d", K_LOWEST_APPLICATION_THREAD_PRIO);
+		return -EINVAL;
+	}
+	slot = taskPoolAdd(&task, gThreadData.policy, PARTITION_CPUS);
+	switch (slot) {
+	case -EINVAL:
+		shell_error(shell, "invalid period, execution time, mutex, overrun policy, budget, reserve, "
+					"kernel or working set");
+		return slot;
+	case -EEXIST:
+		shell_error(shell, "a task named %s exists", task.t_name);
+		return slot;
+	case -ENOMEM:
+		shell_error(shell, "all %d spare task slots are in use", MAX_TASKS - NUM_THREADS);
+		return slot;
+	case -EDEADLK:
+		shell_error(shell, "%s rejected, the task set would miss deadlines:", task.t_name);
+		taskPoolAnalyse(&task, TASK_POOL_ALL, gThreadData.policy, PARTITION_CPUS, set, slots, &n);
+		printAdmission(shell, set, n);
+		return slot;
+	default:
+		shell_print(shell, "%s admitted to slot %d", task.t_name, slot);
+		return 0;
+	}
+}
+
+int taskRemove(const struct shell *shell, size_t argc, char **argv) {
+	int slot = taskPoolFind(argv[1]);
+
+	ARG_UNUSED(argc);
+	if (isRunning(shell)) {
+		return -EBUSY;
+	}
+	if (slot < 0) {
+		shell_error(shell, "no task named %s", argv[1]);
+		return slot;
+	}
+	taskPoolRemove(slot);
+	shell_print(shell, "%s removed from slot %d", argv[1], slot);
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(taskCommands,
+	SHELL_CMD(list, NULL, "List the task set and its analysis", taskList),
+	SHELL_CMD_ARG(add, NULL, "Admit a task: <name> <priority> <period ms> <c1 us> <c2 us> "
+				  "<c3 us> <mutex> [continue|skip|abort] [reserve us] "
+				  "[alu|stream|chase|thrash|math] [working set bytes]", taskAdd, 8, 4),
+	SHELL_CMD_ARG(remove, NULL, "Remove a task: <name>", taskRemove, 2, 0),
+	SHELL_SUBCMD_SET_END
+);
+SHELL_CMD_REGISTER(task, &taskCommands, "Runtime task set", NULL);
+
+/*
+ * This is the entry point function for the root shell command "mode".
+ * Without an argument it lists the modes and their tasks. Between runs
+ * "mode <name>" selects the mode the next run starts in; during a run it
+ * requests a mode change, carried out by the dispatcher at its next expiry.
+ * A mode is only accepted if its task set passes the admission analysis.
+ */
+int mode(const struct shell *shell, size_t argc, char **argv) {
+	struct schedTask set[MAX_TASKS];
+	int slots[MAX_TASKS];
+	int n, next = -1;
+
+	if (argc < 2) {
+		for (int m = 0; m < NUM_MODES; m++) {
+			uint32_t mask = taskPoolModeSlots(m);
+			shell_print(shell, "%s%s:", modes[m].m_name, m == gThreadData.mode ? " (current)" : "");
+			for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+				if (mask & (1U << i)) {
+					shell_print(shell, "  %s", taskPoolGet(i)->t_name);
+				}
+			}
+		}
+		return 0;
+	}
+	for (int m = 0; m < NUM_MODES; m++) {
+		if (!strcmp(argv[1], modes[m].m_name)) {
+			next = m;
+		}
+	}
+	if (next < 0) {
+		shell_error(shell, "unknown mode: %s", argv[1]);
+		return -EINVAL;
+	}
+	if (!taskPoolModeSlots(next)) {
+		shell_error(shell, "no task runs in mode %s", argv[1]);
+		return -ENOEXEC;
+	}
+	if (taskPoolAnalyse(NULL, taskPoolModeSlots(next), gThreadData.policy, PARTITION_CPUS,
+						set, slots, &n)) {
+		shell_error(shell, "mode %s rejected, its task set can miss deadlines:", argv[1]);
+		printAdmission(shell, set, n);
+		return -EDEADLK;
+	}
+	if (gThreadData.cyclic && atomic_get(&gThreadData.running)) {
+		shell_error(shell, "the cyclic executive has no modes");
+		return -ENOTSUP;
+	}
+	if (!atomic_get(&gThreadData.running)) {
+		gThreadData.mode = next;
+		shell_print(shell, "the next run starts in mode %s", argv[1]);
+		return 0;
+	}
+	if (!atomic_cas(&gThreadData.pendingMode, -1, next)) {
+		shell_error(shell, "a mode change is already in progress");
+		return -EBUSY;
+	}
+	shell_print(shell, "changing to mode %s", argv[1]);
+	return 0;
 }
-SHELL_CMD_REGISTER(activate, NULL, "Activating all the threads", activate);
+SHELL_CMD_ARG_REGISTER(mode, NULL, "List the modes, or switch to one [name]", mode, 1, 1);
+
+/*
+ * This is the entry point function for the root shell command "threshold",
+ * which turns the preemption thresholds of the task set on or off for the
+ * following runs, so that the context switches of both can be compared.
+ */
+int threshold(const struct shell *shell, size_t argc, char **argv) {
+	if (argc > 1) {
+		if (isRunning(shell)) {
+			return -EBUSY;
+		}
+		if (strcmp(argv[1], "on") && strcmp(argv[1], "off")) {
+			shell_error(shell, "usage: threshold [on|off]");
+			return -EINVAL;
+		}
+		gThreadData.useThresholds = !strcmp(argv[1], "on");
+	}
+	shell_print(shell, "preemption thresholds %s", gThreadData.useThresholds ? "on" : "off");
+	return 0;
+}
+SHELL_CMD_ARG_REGISTER(threshold, NULL, "Use the preemption thresholds of the task set [on|off]",
+					   threshold, 1, 1);
 
 /*
  * Definitions of member functions.
  */
+
+/*
+ * Mixed criticality. A job's execution is accounted with the runtime stats
+ * of its thread, including the slice it is running, and checked against
+ * the budget of the current criticality mode at the segment boundaries,
+ * whether or not the job was preempted. In LO mode a HI task past its LO
+ * budget switches the system to HI mode and carries on with its HI budget;
+ * the jobs of LO tasks are then abandoned and their releases dropped, or
+ * thinned out to every MC_DEGRADE_FACTOR-th. The system returns to LO mode
+ * at the first instant at which no released job is left.
+ */
+void startBudget(struct threadTimerData *threadData) {
+#ifdef CONFIG_APP_MIXED_CRITICALITY
+	threadData->jobStartCycles = threadExecutionCycles(k_current_get());
+#endif
+}
+
+void switchToHiMode(int taskNumber, uint32_t seq) {
+	if (!atomic_cas(&gThreadData.critMode, CRIT_LO, CRIT_HI)) {
+		return;
+	}
+	atomic_inc(&gThreadData.critSwitches);
+	traceLog(taskNumber, TRACE_CRIT_HI, taskNumber, seq);
+	if (MC_DEGRADE_FACTOR) {
+		return;
+	}
+	/* Every job handed to a LO task is abandoned at its next segment boundary */
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		if (taskPoolGet(i)->criticality == CRIT_LO) {
+			atomic_set(&threadSpecificData[i].abortSeq, threadSpecificData[i].queuedSeq);
+		}
+	}
+}
+
+/*
+ * Checked by a task between its segments. Returns true when the job has to
+ * stop because it used up the budget of the current mode.
+ */
+bool isOverBudget(struct threadTimerData *threadData, uint32_t seq) {
+#ifdef CONFIG_APP_MIXED_CRITICALITY
+	uint64_t used = threadExecutionCycles(k_current_get()) - threadData->jobStartCycles;
+	int crit = (int)atomic_get(&gThreadData.critMode);
+
+	if (used <= threadData->budgetCycles[crit]) {
+		return false;
+	}
+	if (crit == CRIT_LO && taskPoolGet(threadData->taskNumber)->criticality == CRIT_HI) {
+		switchToHiMode(threadData->taskNumber, seq);
+		return used > threadData->budgetCycles[CRIT_HI];
+	}
+	return true;
+#else
+	ARG_UNUSED(threadData);
+	ARG_UNUSED(seq);
+	return false;
+#endif
+}
+
+/* Called by the dispatcher, LO tasks lose their releases in HI mode */
+bool isDroppedInHiMode(struct threadTimerData *threadData, uint32_t seq) {
+	return atomic_get(&gThreadData.critMode) == CRIT_HI &&
+		   taskPoolGet(threadData->taskNumber)->criticality == CRIT_LO &&
+		   (MC_DEGRADE_FACTOR == 0 || seq % MC_DEGRADE_FACTOR);
+}
+
+/* Called by a task for every released job it finishes, abandons or drops */
+void endJob(int taskNumber, uint32_t seq) {
+	if (atomic_dec(&gThreadData.pendingJobs) == 1 &&
+		atomic_cas(&gThreadData.critMode, CRIT_HI, CRIT_LO)) {
+		traceLog(taskNumber, TRACE_CRIT_LO, taskNumber, seq);
+	}
+}
+
 void initTimerData(int taskNumber) {
-	k_timer_init(&threadDeadlineTimers[taskNumber], threadDeadlineHandler, NULL);
-	k_timer_user_data_set(&threadDeadlineTimers[taskNumber], (void*)&threadSpecificData[taskNumber]);
-	threadSpecificData[taskNumber].timestamp = k_uptime_get();
-	threadSpecificData[taskNumber].taskNumber = taskNumber;
-	threadSpecificData[taskNumber].taskCompleted = ATOMIC_INIT(0);
-	k_mutex_init(&mutex[threads[taskNumber].mutex_m]);
+	struct threadTimerData *threadData = &threadSpecificData[taskNumber];
+	k_msgq_init(&threadData->releaseQueue, (char *)threadData->releaseBuffer,
+				sizeof(uint32_t), RELEASE_QUEUE_DEPTH);
+	threadData->taskNumber = taskNumber;
+	threadData->periodCycles = k_ms_to_cyc_ceil32(taskPoolGet(taskNumber)->period);
+	threadData->periodTicks = k_ms_to_ticks_ceil64(taskPoolGet(taskNumber)->period);
+	threadData->releaseSeq = 0;
+	threadData->queuedSeq = 0;
+	threadData->completedSeq = ATOMIC_INIT(0);
+	threadData->abortSeq = ATOMIC_INIT(0);
+	threadData->jobCount = ATOMIC_INIT(0);
+	threadData->missCount = ATOMIC_INIT(0);
+	threadData->skipCount = ATOMIC_INIT(0);
+	threadData->abortCount = ATOMIC_INIT(0);
+	threadData->budgetCount = ATOMIC_INIT(0);
+	threadData->critDropCount = ATOMIC_INIT(0);
+	for (int crit = CRIT_LO; crit <= CRIT_HI; crit++) {
+		threadData->budgetCycles[crit] = k_us_to_cyc_ceil32(taskPoolGet(taskNumber)->budget_us[crit]);
+	}
+	jobStatsInit(taskNumber, taskPoolGet(taskNumber)->period * USEC_PER_MSEC);
 	gThreadData.exitFlag = ATOMIC_INIT(0);
 }
 void setTidInUserData(int taskNumber, k_tid_t tid) {
@@ -95,35 +703,361 @@ void setTidInUserData(int taskNumber, k_tid_t tid) {
 void setTidInGlobalData(int taskNumber, k_tid_t tid) {
 	gThreadData.spawnedTids[taskNumber] = tid;
 }
-void updateTimestampInUserData(int taskNumber) {
-	threadSpecificData[taskNumber].timestamp = k_uptime_get();
+
+/*
+ * Under EDF every task runs at the most urgent priority of the task set and
+ * the deadline scheduler orders them by their absolute deadlines.
+ */
+int getRunPriority(int taskNumber) {
+	int priority = taskPoolGet(taskNumber)->priority;
+	if (gThreadData.policy == POLICY_EDF) {
+		for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+			priority = MIN(priority, taskPoolGet(i)->priority);
+		}
+	}
+	return priority;
+}
+
+/*
+ * Priority a started job runs at: its preemption threshold under RM, so
+ * only tasks more urgent than the threshold preempt it, and its run
+ * priority under EDF or with thresholds off.
+ */
+int getJobPriority(int taskNumber) {
+	if (gThreadData.policy == POLICY_EDF || !gThreadData.useThresholds) {
+		return getRunPriority(taskNumber);
+	}
+	return taskPoolGet(taskNumber)->threshold;
+}
+
+/* Raises a task to its threshold when a job starts and drops it back when the job ends */
+void setJobPriority(struct threadTimerData *threadData, bool started) {
+	int taskNumber = threadData->taskNumber;
+
+	switchCountJob(taskNumber, started);
+	if (getJobPriority(taskNumber) != getRunPriority(taskNumber)) {
+		cbsSetPriority(&threadData->server,
+					   started ? getJobPriority(taskNumber) : getRunPriority(taskNumber));
+	}
+}
+
+/*
+ * @function initMutexes
+ *
+ * @brief Computes the ceiling of every mutex from the mutex_m fields of the
+ * 		  task set: the most urgent run priority among the tasks locking it.
+ */
+void initMutexes(void) {
+	for (int m = 0; m < NUM_MUTEXES; m++) {
+		int ceiling = K_LOWEST_APPLICATION_THREAD_PRIO;
+		for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+			if (taskPoolGet(i)->mutex_m == m) {
+				ceiling = MIN(ceiling, getRunPriority(i));
+			}
+		}
+		ceilingMutexInit(&mutex[m], ceiling);
+	}
+}
+
+/*
+ * This is the entry point function for the root shell command "locks". It
+ * prints the measured wait and hold times of every mutex next to the
+ * longest critical section the task model declares for it.
+ */
+int locks(const struct shell *shell, size_t argc, char **argv) {
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	for (int m = 0; m < NUM_MUTEXES; m++) {
+		char name[16];
+		int critical = 0;
+		for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+			if (taskPoolGet(i)->mutex_m == m) {
+				critical = MAX(critical, taskPoolGet(i)->exec_us[1]);
+			}
+		}
+		snprintf(name, sizeof(name), "mutex%d", m);
+		ceilingMutexPrint(shell, name, &mutex[m]);
+		shell_print(shell, "  model: longest critical section %d us", critical);
+	}
+	return 0;
+}
+SHELL_CMD_REGISTER(locks, NULL, "Measured wait and hold times of the mutexes", locks);
+
+/*
+ * @function partitionTasks
+ *
+ * @brief Assigns every task to a core with the utilisation based bin
+ * 		  packing of sched_analysis.c. Without partitioned SMP every task is
+ * 		  left on core 0 and no CPU mask is applied.
+ */
+void partitionTasks(void) {
+	struct schedTask set[MAX_TASKS];
+	int slots[MAX_TASKS];
+	int misfits = 0;
+	int n = 0;
+
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		schedTaskFromModel(taskPoolGet(i), &set[n]);
+		slots[n++] = i;
+	}
+#ifdef CONFIG_APP_SMP_PARTITIONED
+	misfits = schedPartition(set, n, CONFIG_MP_NUM_CPUS, gThreadData.policy);
+#endif
+	for (int k = 0; k < n; k++) {
+		threadSpecificData[slots[k]].cpu = set[k].cpu;
+	}
+	if (misfits) {
+		shell_warn(gThreadData.shell, "%d task(s) fit on no core by utilisation", misfits);
+	}
+}
+
+/* Stack of a slot of the pool, its usable size is returned in size */
+k_thread_stack_t *getSlotStack(int slot, size_t *size) {
+	static k_thread_stack_t *const modelStacks[NUM_THREADS] = {
+		taskStack0, taskStack1, taskStack2, taskStack3,
+	};
+	static const size_t modelSizes[NUM_THREADS] = {
+		K_THREAD_STACK_SIZEOF(taskStack0), K_THREAD_STACK_SIZEOF(taskStack1),
+		K_THREAD_STACK_SIZEOF(taskStack2), K_THREAD_STACK_SIZEOF(taskStack3),
+	};
+
+	if (slot < NUM_THREADS) {
+		*size = modelSizes[slot];
+		return modelStacks[slot];
+	}
+	*size = K_THREAD_STACK_SIZEOF(spareStacks[slot - NUM_THREADS]);
+	return spareStacks[slot - NUM_THREADS];
+}
+
+/* Nominal release of job seq in cycles: origin + (seq - 1) periods after the epoch */
+uint32_t getReleaseCycle(struct threadTimerData *threadData, uint32_t seq) {
+	return gThreadData.epochCycle +
+		(uint32_t)k_ticks_to_cyc_floor64(threadData->originTick - gThreadData.epochTick +
+										 (int64_t)(seq - 1) * threadData->periodTicks);
+}
+
+/* Absolute deadline of job seq in cycles: one period after its release */
+uint32_t getDeadlineCycle(struct threadTimerData *threadData, uint32_t seq) {
+	return getReleaseCycle(threadData, seq) + threadData->periodCycles;
+}
+
+/*
+ * Hands the absolute deadline of job seq to the deadline scheduler under EDF.
+ * The deadline of a reserved task is the one of its server.
+ */
+void setJobDeadline(struct threadTimerData *threadData, uint32_t seq) {
+#ifdef CONFIG_SCHED_DEADLINE
+	if (gThreadData.policy == POLICY_EDF && !threadData->server.budget) {
+		k_thread_deadline_set(threadData->tid,
+			(int)(getDeadlineCycle(threadData, seq) - k_cycle_get_32()));
+	}
+#endif
 }
-int64_t getTimestampInUserData(int taskNumber) {
-	return threadSpecificData[taskNumber].timestamp;
+
+/* Least common multiple of the task periods in milliseconds */
+uint64_t getHyperperiod(void) {
+	uint64_t hyperperiod = 1;
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		uint64_t a = hyperperiod, b = taskPoolGet(i)->period;
+		while (b) {
+			uint64_t r = a % b;
+			a = b;
+			b = r;
+		}
+		hyperperiod = hyperperiod / a * taskPoolGet(i)->period;
+	}
+	return hyperperiod;
 }
 
 /*
  * Defining timer exipiry handlers
  */
 
-/* Handler for thread deadline expiry*/
-void threadDeadlineHandler(struct k_timer *timer) {
-	struct threadTimerData *threadData = (struct threadTimerData*)k_timer_user_data_get(timer);
-	int taskNumber = threadData->taskNumber;
-	if(atomic_get(&threadData->taskCompleted)) {
-		atomic_dec(&threadData->taskCompleted);
-	} else {
-		printk("Deadline for the task: %d has missed\n", taskNumber);
+/*
+ * @function releaseJob
+ *
+ * @brief Releases job seq of a task from the dispatcher ISR. The release of
+ * 		  a job is the deadline of the previous one, so this is also where a
+ * 		  miss is detected: jobs finish in order, so job seq - 1 is late if
+ * 		  it was handed to the task and completedSeq has not reached it. When
+ * 		  a handed job is still unfinished the task's overrun policy decides
+ * 		  what happens. Only atomic counters are updated, nothing is printed.
+ */
+void releaseJob(struct threadTimerData *threadData, uint32_t seq) {
+	uint32_t completed = (uint32_t)atomic_get(&threadData->completedSeq);
+	bool overrun = completed < threadData->queuedSeq;
+
+	if (threadData->queuedSeq == seq - 1 && overrun) {
+		atomic_inc(&threadData->missCount);
+		traceLog(TRACE_DISPATCHER, TRACE_DEADLINE_MISS, threadData->taskNumber, seq - 1);
+	}
+	if (isDroppedInHiMode(threadData, seq)) {
+		atomic_inc(&threadData->critDropCount);
+		traceLog(TRACE_DISPATCHER, TRACE_RELEASE_SKIP, threadData->taskNumber, seq);
+		return;
+	}
+	if (overrun) {
+		switch (taskPoolGet(threadData->taskNumber)->overrun) {
+		case OVERRUN_SKIP:
+			atomic_inc(&threadData->skipCount);
+			traceLog(TRACE_DISPATCHER, TRACE_RELEASE_SKIP, threadData->taskNumber, seq);
+			return;
+		case OVERRUN_ABORT:
+			atomic_set(&threadData->abortSeq, threadData->queuedSeq);
+			break;
+		default:
+			break;
+		}
+	}
+	if (k_msgq_put(&threadData->releaseQueue, &seq, K_NO_WAIT)) {
+		atomic_inc(&threadData->skipCount);
+		traceLog(TRACE_DISPATCHER, TRACE_RELEASE_SKIP, threadData->taskNumber, seq);
+		return;
+	}
+	threadData->queuedSeq = seq;
+	atomic_inc(&gThreadData.pendingJobs);
+	if (!overrun) {
+		setJobDeadline(threadData, seq);
+	}
+}
+
+/*
+ * Delay of a job's start by a lower priority task inside a critical section
+ * whose ceiling kept this task from running, in cycles.
+ */
+uint32_t getStartBlocking(int taskNumber, uint32_t release, uint32_t start) {
+	uint32_t blocked = 0;
+	for (int m = 0; m < NUM_MUTEXES; m++) {
+		blocked = MAX(blocked, ceilingMutexBlocking(&mutex[m], getRunPriority(taskNumber),
+													release, start));
+	}
+	return blocked;
+}
+
+/* Checked by a task between its segments */
+bool isJobAborted(struct threadTimerData *threadData, uint32_t seq) {
+	return seq <= (uint32_t)atomic_get(&threadData->abortSeq);
+}
+
+/*
+ * @function modeChangeStep
+ *
+ * @brief Runs the mode change protocol from the dispatcher at tick now. When
+ * 		  a change is requested, the tasks leaving the mode are retired: they
+ * 		  get no further release, the job they are running finishes and the
+ * 		  jobs still queued are dropped. The tasks entering the mode are only
+ * 		  released once every retired job has completed, the first of them at
+ * 		  that expiry, so retired and new tasks never compete for a core and
+ * 		  each transient load is bounded by one of the two modes. Unchanged
+ * 		  tasks keep their releases throughout. Returns true while the change
+ * 		  waits for retired jobs.
+ */
+bool modeChangeStep(int64_t now) {
+	int next = (int)atomic_get(&gThreadData.pendingMode);
+	uint32_t slots;
+
+	if (next < 0) {
+		return false;
+	}
+	slots = taskPoolModeSlots(next);
+	if (!gThreadData.retiring) {
+		for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+			struct threadTimerData *threadData = &threadSpecificData[i];
+			uint32_t completed = (uint32_t)atomic_get(&threadData->completedSeq);
+
+			if (!threadData->inMode || (slots & (1U << i))) {
+				continue;
+			}
+			/* Jobs finish in order, so the running job is the one after completed */
+			atomic_set(&threadData->lastSeq,
+					   threadData->queuedSeq > completed ? completed + 1 : completed);
+			threadData->inMode = false;
+			traceLog(TRACE_DISPATCHER, TRACE_TASK_RETIRE, i, atomic_get(&threadData->lastSeq));
+		}
+		gThreadData.retiring = true;
+	}
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		struct threadTimerData *threadData = &threadSpecificData[i];
+		if (!threadData->inMode && (uint32_t)atomic_get(&threadData->completedSeq) <
+			(uint32_t)atomic_get(&threadData->lastSeq)) {
+			return true;
+		}
+	}
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		struct threadTimerData *threadData = &threadSpecificData[i];
+		uint32_t seq = threadData->releaseSeq + 1;
+
+		if (threadData->inMode || !(slots & (1U << i))) {
+			continue;
+		}
+		/* Job seq is released now, later jobs follow one period apart */
+		threadData->originTick = now - (int64_t)(seq - 1) * threadData->periodTicks;
+		threadData->nextRelease = now;
+		atomic_set(&threadData->lastSeq, (atomic_val_t)UINT32_MAX);
+		threadData->inMode = true;
+		traceLog(TRACE_DISPATCHER, TRACE_TASK_ADMIT, i, seq);
+	}
+	gThreadData.mode = next;
+	gThreadData.retiring = false;
+	gThreadData.modeChanges++;
+	atomic_set(&gThreadData.pendingMode, -1);
+	traceLog(TRACE_DISPATCHER, TRACE_MODE_CHANGE, 0, next);
+	return false;
+}
+
+/*
+ * @function releaseHandler
+ *
+ * @brief Handler of the single release timer. Every task is released at
+ * 		  epoch + k * period, computed from the common epoch rather than from
+ * 		  the time the task last woke up, so releases do not drift. All tasks
+ * 		  due at this tick are released from one expiry and the timer is
+ * 		  re-armed at the earliest next release as an absolute timeout. Only
+ * 		  the tasks of the current mode are released; while a mode change
+ * 		  waits for retired jobs the timer also expires every tick. Once the
+ * 		  run has ended the timer is no longer re-armed, so that an expiry
+ * 		  on another cpu cannot restart it after the dispatcher stopped it.
+ */
+void releaseHandler(struct k_timer *timer) {
+	int64_t now = gThreadData.nextDispatch;
+	int64_t next = INT64_MAX;
+	bool changing;
+
+	if (atomic_get(&gThreadData.exitFlag)) {
+		return;
+	}
+	if (gThreadData.dispatchCount++ == 0) {
+		gThreadData.epochCycle = k_cycle_get_32();
+	}
+	changing = modeChangeStep(now);
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		struct threadTimerData *threadData = &threadSpecificData[i];
+		if (!threadData->inMode) {
+			continue;
+		}
+		if (threadData->nextRelease <= now) {
+			releaseJob(threadData, ++threadData->releaseSeq);
+			threadData->nextRelease += threadData->periodTicks;
+		}
+		next = MIN(next, threadData->nextRelease);
+	}
+	if (changing) {
+		next = MIN(next, now + 1);
+	}
+	gThreadData.nextDispatch = next;
+	if (!atomic_get(&gThreadData.exitFlag)) {
+		k_timer_start(timer, K_TIMEOUT_ABS_TICKS(next), K_NO_WAIT);
 	}
-	return;
 }
 
 /* Handler for program exit expiry */
 void threadExitHandler(struct k_timer *timer) {
 	struct globalTimerData *gThreadData = (struct globalTimerData*)k_timer_user_data_get(timer);
+	uint32_t exitSeq = JOB_EXIT;
 	atomic_inc(&gThreadData->exitFlag);
-	for (int i = 0; i< NUM_THREADS; i++) {
-			k_wakeup(gThreadData->spawnedTids[i]);
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+			/* A full queue means the task is busy and will see the exit flag */
+			k_msgq_put(&threadSpecificData[i].releaseQueue, &exitSeq, K_NO_WAIT);
 	}
 	return;
 }
@@ -131,35 +1065,166 @@ void threadExitHandler(struct k_timer *timer) {
 /* 
  * @function taskDispatcher
  *
- * @brief This function is called from the activate command and will initialise the 
- * 		  global datastructures, launches the individual tasks. Post intialization,
- * 		  the k_timer_status_sync will wait for the TOTAL_TIME to be elapsed. After
+ * @brief This function is run by the runner thread for the activate command and will
+ * 		  initialise the global datastructures, launches the individual tasks. Post intialization,
+ * 		  the k_timer_status_sync will wait for the run length to be elapsed. After
  * 		  the timer expires, all the spawned threads are joined into this main thread.
  */
 void taskDispatcher(void) {
+	/* Events of the run are printed by the trace drain thread */
+	traceLogStart(gThreadData.shell);
 	/* Timier initialisations */
 	k_timer_init(&exitTimer, threadExitHandler, NULL);
 	k_timer_user_data_set(&exitTimer, (void*)&gThreadData);
-	k_timer_start(&exitTimer, K_MSEC(TOTAL_TIME), K_NO_WAIT);
-	for (int i = 0; i < NUM_THREADS; i++) {
+	k_timer_start(&exitTimer, K_MSEC(gThreadData.runMs), K_NO_WAIT);
+	workloadReset();
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
 		initTimerData(i);
+		if (workloadPrepare(i, taskPoolGet(i)) && !gThreadData.quiet) {
+			shell_warn(gThreadData.shell, "working set of %s shares memory, the arena is full",
+					   taskPoolGet(i)->t_name);
+		}
 	}
-	/* Launching the individual threads */
-	for (int i = 0; i < NUM_THREADS; i++) {
-		shell_info(gThreadData.shell, "launching task: %d\n", i);
+	initMutexes();
+	partitionTasks();
+	chainInit();
+	/* Launching the individual threads, they wait for their first release */
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		if (!gThreadData.quiet) {
+			shell_info(gThreadData.shell, "launching task: %d\n", i);
+		}
 		launchTask(i);
 	}
+	/*
+	 * The tasks of the current mode are first released together one tick
+	 * from now. Every pool task has a thread, so a mode change never has to
+	 * create one; the others wait for a mode that includes them.
+	 */
+	gThreadData.epochTick = k_uptime_ticks() + 1;
+	gThreadData.nextDispatch = gThreadData.epochTick;
+	gThreadData.dispatchCount = 0;
+	gThreadData.retiring = false;
+	gThreadData.modeChanges = 0;
+	atomic_set(&gThreadData.pendingMode, -1);
+	atomic_set(&gThreadData.critMode, CRIT_LO);
+	atomic_set(&gThreadData.pendingJobs, 0);
+	atomic_set(&gThreadData.critSwitches, 0);
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		struct threadTimerData *threadData = &threadSpecificData[i];
+		threadData->inMode = taskPoolModeSlots(gThreadData.mode) & (1U << i);
+		threadData->originTick = gThreadData.epochTick;
+		threadData->nextRelease = gThreadData.epochTick;
+		atomic_set(&threadData->lastSeq, threadData->inMode ? (atomic_val_t)UINT32_MAX : 0);
+	}
+	k_timer_init(&releaseTimer, releaseHandler, NULL);
+	k_timer_start(&releaseTimer, K_TIMEOUT_ABS_TICKS(gThreadData.epochTick), K_NO_WAIT);
 	/* Waiting for the total timer to expire */
 	k_timer_status_sync(&exitTimer);
-	for (int i = 0; i < NUM_THREADS; i++) {
-		k_timer_stop(&threadDeadlineTimers[i]);
-	}
+	/*
+	 * On SMP the exit handler may still be running on another cpu, so the
+	 * flag is set here as well before the release timer is stopped; an
+	 * expiry that sees it does not re-arm the timer. One that was already
+	 * past the check is over by the time the threads are joined, and the
+	 * timer is stopped once more there.
+	 */
+	atomic_set(&gThreadData.exitFlag, 1);
+	k_timer_stop(&releaseTimer);
 	k_timer_stop(&exitTimer);
 	/* Cleaning up the finished threads */
-	for (int i = 0; i < NUM_THREADS; i++) {
-		shell_info(gThreadData.shell, "joining thread: %d \n", i);
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		if (!gThreadData.quiet) {
+			shell_info(gThreadData.shell, "joining thread: %d \n", i);
+		}
 		k_thread_join(&threadStruct[i], K_FOREVER);
+		cbsStop(&threadSpecificData[i].server);
+		/* Benchmark sets are synthetic, their stacks say nothing about stack_table.h */
+		if (!gThreadData.quiet) {
+			stackProfileRecord(i, &threadStruct[i], threadSpecificData[i].stackSize);
+		}
+	}
+	k_timer_stop(&releaseTimer);
+	traceLogSync();
+	if (!gThreadData.quiet) {
+		printMissSummary();
+	}
+}
+
+/* 
+ * @function printMissSummary
+ *
+ * @brief Prints one line per task with the jobs run and the deadlines missed,
+ * 		  tagged with the policy so that RM and EDF runs can be compared.
+ */
+void printMissSummary(void) {
+	const char *policy = gThreadData.policy == POLICY_EDF ? "EDF" : "RM";
+	uint32_t releases = 0;
+	int total = 0;
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		struct threadTimerData *threadData = &threadSpecificData[i];
+		int misses = atomic_get(&threadData->missCount);
+		shell_print(gThreadData.shell, "[%s] %s: %d jobs, %d deadline misses, %d skipped, %d aborted",
+					policy, taskPoolGet(i)->t_name, (int)atomic_get(&threadData->jobCount), misses,
+					(int)atomic_get(&threadData->skipCount), (int)atomic_get(&threadData->abortCount));
+		total += misses;
+		releases += threadData->releaseSeq;
+	}
+	shell_print(gThreadData.shell, "[%s] total: %d deadline misses", policy, total);
+#ifdef CONFIG_APP_COUNT_SWITCHES
+	uint32_t switches = 0, preemptions = 0;
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		shell_print(gThreadData.shell, "[%s] %s: threshold %d, %u context switches, %u preemptions",
+					policy, taskPoolGet(i)->t_name, getJobPriority(i), switchCountSwitches(i),
+					switchCountPreemptions(i));
+		switches += switchCountSwitches(i);
+		preemptions += switchCountPreemptions(i);
+	}
+	shell_print(gThreadData.shell, "[%s] thresholds %s: %u context switches, %u preemptions", policy,
+				gThreadData.useThresholds ? "on" : "off", switches, preemptions);
+#endif
+	shell_print(gThreadData.shell, "[%s] %u mode changes, ended in mode %s", policy,
+				gThreadData.modeChanges, modes[gThreadData.mode].m_name);
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		const struct cbsServer *server = &threadSpecificData[i].server;
+		if (server->budget) {
+			shell_print(gThreadData.shell, "[%s] %s: reserved %d us per %d ms, %u deadlines "
+						"postponed, %u times throttled", policy, taskPoolGet(i)->t_name,
+						taskPoolGet(i)->reserve_us, taskPoolGet(i)->period,
+						server->postponeCount, server->throttleCount);
+		}
 	}
+#ifdef CONFIG_APP_MIXED_CRITICALITY
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		struct threadTimerData *threadData = &threadSpecificData[i];
+		shell_print(gThreadData.shell, "[%s] %s (%s): %d jobs stopped at their budget, "
+					"%d releases dropped in HI mode", policy, taskPoolGet(i)->t_name,
+					taskPoolGet(i)->criticality == CRIT_HI ? "HI" : "LO",
+					(int)atomic_get(&threadData->budgetCount),
+					(int)atomic_get(&threadData->critDropCount));
+	}
+	shell_print(gThreadData.shell, "[%s] %d switches to HI criticality, ended in %s mode", policy,
+				(int)atomic_get(&gThreadData.critSwitches),
+				atomic_get(&gThreadData.critMode) == CRIT_HI ? "HI" : "LO");
+#endif
+#ifdef CONFIG_APP_SMP_PARTITIONED
+	for (int cpu = 0; cpu < CONFIG_MP_NUM_CPUS; cpu++) {
+		uint32_t cpuReleases = 0;
+		uint32_t cpuMisses = 0;
+		int cpuTasks = 0;
+		for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+			if (threadSpecificData[i].cpu == cpu) {
+				cpuTasks++;
+				cpuReleases += threadSpecificData[i].releaseSeq;
+				cpuMisses += atomic_get(&threadSpecificData[i].missCount);
+			}
+		}
+		/* Miss rate in hundredths of a percent of the releases */
+		uint32_t rate = cpuReleases ? cpuMisses * 10000U / cpuReleases : 0;
+		shell_print(gThreadData.shell, "[%s] cpu%d: %d tasks, %u releases, %u misses, miss rate %u.%02u%%",
+					policy, cpu, cpuTasks, cpuReleases, cpuMisses, rate / 100, rate % 100);
+	}
+#endif
+	shell_print(gThreadData.shell, "[%s] %u releases from %u timer expiries, hyperperiod %llu ms",
+				policy, releases, gThreadData.dispatchCount, (unsigned long long)getHyperperiod());
 }
 
 /* 
@@ -169,60 +1234,155 @@ void taskDispatcher(void) {
  *  
  */
 void launchTask(int taskNumber) {
-	struct task_s* taskInfo = &threads[taskNumber];
-	k_tid_t myTid = k_thread_create(&threadStruct[taskNumber], threadStackGlobal[taskNumber],
-                                 K_THREAD_STACK_SIZEOF(threadStackGlobal[taskNumber]),
+	const struct task_s* taskInfo = taskPoolGet(taskNumber);
+	k_thread_stack_t *stack = getSlotStack(taskNumber, &threadSpecificData[taskNumber].stackSize);
+	k_tid_t myTid = k_thread_create(&threadStruct[taskNumber], stack,
+                                 threadSpecificData[taskNumber].stackSize,
                                  (k_thread_entry_t)threadFunction,
-                                 taskInfo, (void*)taskNumber, NULL,
-                                 taskInfo->priority, 0, K_FOREVER);
+                                 (void*)taskInfo, (void*)taskNumber, NULL,
+                                 getRunPriority(taskNumber), 0, K_FOREVER);
 	setTidInUserData(taskNumber, myTid);
-	/* 
-	 * Caching the threadID of the spwaned threads to use them in 
-	 * k_wakeup() api in @threadExitHandler() function call.
-	 */
+	cbsInit(&threadSpecificData[taskNumber].server, myTid, taskInfo->reserve_us,
+			taskInfo->period * USEC_PER_MSEC, getRunPriority(taskNumber),
+			gThreadData.policy == POLICY_EDF);
+#ifdef CONFIG_APP_SMP_PARTITIONED
+	/* Pinning the thread to its core while it is not yet runnable */
+	k_thread_cpu_mask_clear(myTid);
+	k_thread_cpu_mask_enable(myTid, threadSpecificData[taskNumber].cpu);
+#endif
+	switchCountStart(taskNumber, &threadStruct[taskNumber]);
+	/* Caching the threadID of the spwaned threads. */
 	setTidInGlobalData(taskNumber, myTid);
 	k_thread_name_set(&threadStruct[taskNumber], taskInfo->t_name);
 	k_thread_start(&threadStruct[taskNumber]);
 } 
 
-/*
- * @function compute: compute function to keep the CPU busy.
- */
-void compute(int numiterations) {
-	volatile uint64_t x = numiterations;
-	while(x > 0)
-		x--;
-}
-
 /*
  * @function threadFunction: Entry point for all the thread functions
  * 							 spawned in @launchTask() function call.
  */
-void threadFunction(struct task_s *taskInfo, int taskNumber, void* dummy) {
+void threadFunction(const struct task_s *taskInfo, int taskNumber, void* dummy) {
 	ARG_UNUSED(dummy);
-	while(!atomic_get(&gThreadData.exitFlag)) {
-		/* Starting the deadline timer */
-		k_timer_start(&threadDeadlineTimers[taskNumber], K_MSEC(taskInfo->period), K_MSEC(taskInfo->period));
-		updateTimestampInUserData(taskNumber);
-		/* Compute sequence */
-		compute(taskInfo->loop_iter[0]);
-		k_mutex_lock(&mutex[taskInfo->mutex_m], K_FOREVER);
-		compute(taskInfo->loop_iter[1]);
-		k_mutex_unlock(&mutex[taskInfo->mutex_m]);
-		compute(taskInfo->loop_iter[2]);
+	struct threadTimerData *threadData = &threadSpecificData[taskNumber];
+	struct jobRecord job;
+	while(1) {
+		/* Putting the thread to sleep till the dispatcher releases the next job */
+		k_msgq_get(&threadData->releaseQueue, &job.seq, K_FOREVER);
+		if (job.seq == JOB_EXIT || atomic_get(&gThreadData.exitFlag)) {
+			break;
+		}
+		if (job.seq > (uint32_t)atomic_get(&threadData->lastSeq)) {
+			/* Queued before the task was retired by a mode change */
+			atomic_set(&threadData->completedSeq, job.seq);
+			endJob(taskNumber, job.seq);
+			continue;
+		}
+		job.release = getReleaseCycle(threadData, job.seq);
+		job.start = k_cycle_get_32();
+		startBudget(threadData);
+		cbsJobStart(&threadData->server, job.release);
+		setJobPriority(threadData, true);
+		chainJobStart(taskNumber, job.start);
+		job.blocked = getStartBlocking(taskNumber, job.release, job.start);
+		traceLog(taskNumber, TRACE_JOB_START, taskNumber, job.seq);
+		/* A job queued behind a late one carries its own deadline */
+		setJobDeadline(threadData, job.seq);
+		/* Compute sequence, an aborted job is abandoned between segments */
+		if (isJobAborted(threadData, job.seq)) {
+			goto aborted;
+		}
+		computeSegment(taskNumber, 0, taskInfo->exec_us[0]);
+		if (isOverBudget(threadData, job.seq)) {
+			goto overBudget;
+		}
+		if (isJobAborted(threadData, job.seq)) {
+			goto aborted;
+		}
+		job.request = k_cycle_get_32();
+		cbsEnterCritical(&threadData->server);
+		ceilingMutexLock(&mutex[taskInfo->mutex_m]);
+		job.locked = k_cycle_get_32();
+		computeSegment(taskNumber, 1, taskInfo->exec_us[1]);
+		ceilingMutexUnlock(&mutex[taskInfo->mutex_m]);
+		cbsLeaveCritical(&threadData->server);
+		job.unlocked = k_cycle_get_32();
+		if (isOverBudget(threadData, job.seq)) {
+			goto overBudget;
+		}
+		if (isJobAborted(threadData, job.seq)) {
+			goto aborted;
+		}
+		computeSegment(taskNumber, 2, taskInfo->exec_us[2]);
+		job.finish = k_cycle_get_32();
+		/* A HI job past its LO budget in its last segment still switches the mode */
+		(void)isOverBudget(threadData, job.seq);
+		cbsJobEnd(&threadData->server);
+		chainJobEnd(taskNumber, job.finish);
+		job.lateness = (int32_t)(job.finish - getDeadlineCycle(threadData, job.seq));
+		jobStatsRecord(taskNumber, &job);
+		if (gThreadData.measureWcet) {
+			wcetRecord(taskNumber, &job);
+		}
 		/* 
-		 * Setting the taskCompleted flag of the respective thread to help 
-		 * the @threadDeadlineHandler() call identify if a task is completed
+		 * Publishing the sequence number of the finished job to help 
+		 * the @releaseJob() call identify if a job is completed
 		 * or not.
 		 */
-		atomic_inc(&threadSpecificData[taskNumber].taskCompleted);
-		shell_info(gThreadData.shell, "Completed the compute task and set the flag for task: %d\n", taskNumber);
-		/* Putting the thread to sleep till the deadline timer expires */
-		k_timer_status_sync(&threadDeadlineTimers[taskNumber]);
+		atomic_set(&threadData->completedSeq, job.seq);
+		atomic_inc(&threadData->jobCount);
+		/* No console I/O here, the drain thread prints the event later */
+		traceLog(taskNumber, TRACE_JOB_DONE, taskNumber, job.seq);
+		endJob(taskNumber, job.seq);
+		setJobPriority(threadData, false);
+		continue;
+overBudget:
+		atomic_inc(&threadData->budgetCount);
+aborted:
+		cbsJobEnd(&threadData->server);
+		atomic_set(&threadData->completedSeq, job.seq);
+		atomic_inc(&threadData->abortCount);
+		traceLog(taskNumber, TRACE_JOB_ABORT, taskNumber, job.seq);
+		endJob(taskNumber, job.seq);
+		setJobPriority(threadData, false);
+	}
+}
+
+/*
+ * @function runnerThread
+ *
+ * @brief Runs the task set every time startRun() hands it one.
+ */
+void runnerThread(void) {
+	while (1) {
+		k_sem_take(&runStart, K_FOREVER);
+#ifdef CONFIG_APP_CYCLIC_EXECUTIVE
+		if (gThreadData.cyclic) {
+			cyclicRun(gThreadData.shell, TOTAL_TIME);
+			atomic_clear(&gThreadData.running);
+			k_sem_give(&runDone);
+			continue;
+		}
+#endif
+		taskDispatcher();
+		atomic_clear(&gThreadData.running);
+		k_sem_give(&runDone);
 	}
 }
 
 void main(void)
 {
-	/* Nothing to be done in the main function.*/
+	/* The task_model.h set is the initial runtime task set */
+	taskPoolInit();
+	/* Measuring the speed of compute() before any task set is activated */
+	workloadCalibrate();
+	printk("compute(): %u iterations per millisecond\n", workloadIterPerMs());
+#ifdef CONFIG_APP_BENCHMARK_AUTORUN
+	/* Unattended benchmark, e.g. on qemu with bench.conf, once the shell it prints to is up */
+	const struct shell *shell = shell_backend_uart_get_ptr();
+
+	while (shell->ctx->state != SHELL_STATE_ACTIVE) {
+		k_sleep(K_MSEC(10));
+	}
+	benchmark(shell, CONFIG_APP_BENCHMARK_SETS, CONFIG_APP_BENCHMARK_SEED);
+#endif
 }
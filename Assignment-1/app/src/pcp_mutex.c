@@ -0,0 +1,94 @@
+/*
+ * @file
+ * @brief Immediate priority ceiling mutex with blocking measurements.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+#include "pcp_mutex.h"
+
+void ceilingMutexInit(struct ceilingMutex *m, int ceiling) {
+	k_mutex_init(&m->mutex);
+	m->ceiling = ceiling;
+	m->held = false;
+	m->count = 0;
+	m->waitMax = 0;
+	m->holdMax = 0;
+	m->waitSum = 0;
+	m->holdSum = 0;
+}
+
+/*
+ * @function ceilingMutexLock
+ *
+ * @brief Raises the caller to the ceiling, then takes the underlying
+ * 		  k_mutex. On a single CPU the k_mutex is always free at this point,
+ * 		  since a holder runs at the ceiling and the caller could not have
+ * 		  been scheduled; it is kept for exclusion across CPUs.
+ */
+void ceilingMutexLock(struct ceilingMutex *m) {
+	k_tid_t self = k_current_get();
+	int priority = k_thread_priority_get(self);
+	uint32_t start = k_cycle_get_32();
+	uint32_t wait;
+
+	if (m->ceiling < priority) {
+		k_thread_priority_set(self, m->ceiling);
+	}
+	k_mutex_lock(&m->mutex, K_FOREVER);
+	m->lockedAt = k_cycle_get_32();
+	m->savedPriority = priority;
+	m->held = true;
+	wait = m->lockedAt - start;
+	m->waitMax = MAX(m->waitMax, wait);
+	m->waitSum += wait;
+	m->count++;
+}
+
+/* Releases the lock, then drops the caller back to its own priority */
+void ceilingMutexUnlock(struct ceilingMutex *m) {
+	uint32_t hold = k_cycle_get_32() - m->lockedAt;
+	int priority = m->savedPriority;
+
+	m->holdMax = MAX(m->holdMax, hold);
+	m->holdSum += hold;
+	m->unlockedAt = m->lockedAt + hold;
+	m->held = false;
+	k_mutex_unlock(&m->mutex);
+	k_thread_priority_set(k_current_get(), priority);
+}
+
+/*
+ * @function ceilingMutexBlocking
+ *
+ * @brief Returns the cycles of [from, to] during which the mutex was held,
+ * 		  at its last lock, by a task less urgent than priority while its
+ * 		  ceiling kept a task of that priority from running. Under the
+ * 		  immediate ceiling protocol this is the blocking a job released at
+ * 		  from and started at to suffered from this mutex.
+ */
+uint32_t ceilingMutexBlocking(const struct ceilingMutex *m, int priority,
+							  uint32_t from, uint32_t to) {
+	uint32_t lo, hi;
+
+	if (m->ceiling > priority || m->savedPriority <= priority || !m->count) {
+		return 0;
+	}
+	lo = (int32_t)(m->lockedAt - from) > 0 ? m->lockedAt : from;
+	hi = m->held || (int32_t)(m->unlockedAt - to) > 0 ? to : m->unlockedAt;
+	return (int32_t)(hi - lo) > 0 ? hi - lo : 0;
+}
+
+void ceilingMutexPrint(const struct shell *shell, const char *name, const struct ceilingMutex *m) {
+	if (!m->count) {
+		shell_print(shell, "%s: ceiling %d, never locked", name, m->ceiling);
+		return;
+	}
+	shell_print(shell, "%s: ceiling %d, %u locks, wait mean %u max %u us, hold mean %u max %u us",
+				name, m->ceiling, m->count,
+				k_cyc_to_us_floor32((uint32_t)(m->waitSum / m->count)),
+				k_cyc_to_us_floor32(m->waitMax),
+				k_cyc_to_us_floor32((uint32_t)(m->holdSum / m->count)),
+				k_cyc_to_us_floor32(m->holdMax));
+}
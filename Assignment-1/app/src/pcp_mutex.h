@@ -0,0 +1,36 @@
+#ifndef __PCP_MUTEX_H__
+#define __PCP_MUTEX_H__
+
+/*
+ * Immediate priority ceiling mutex. The caller is raised to the ceiling of
+ * the mutex before it takes the lock, so a job is blocked by at most one
+ * lower priority critical section and inheritance never chains. Every lock
+ * records how long the caller waited for it and how long it was held.
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+
+struct ceilingMutex {
+	struct k_mutex mutex;
+	int ceiling;			// most urgent priority of the tasks locking it
+	int savedPriority;		// priority of the holder before the lock
+	uint32_t lockedAt;		// cycle at which the holder acquired it
+	uint32_t unlockedAt;	// cycle at which the last holder released it
+	bool held;
+	/* Measurements, updated by the holder while it holds the lock */
+	uint32_t count;
+	uint32_t waitMax;		// in cycles
+	uint32_t holdMax;		// in cycles
+	uint64_t waitSum;
+	uint64_t holdSum;
+};
+
+void ceilingMutexInit(struct ceilingMutex *m, int ceiling);
+void ceilingMutexLock(struct ceilingMutex *m);
+void ceilingMutexUnlock(struct ceilingMutex *m);
+uint32_t ceilingMutexBlocking(const struct ceilingMutex *m, int priority,
+							  uint32_t from, uint32_t to);
+void ceilingMutexPrint(const struct shell *shell, const char *name, const struct ceilingMutex *m);
+
+#endif // __PCP_MUTEX_H__
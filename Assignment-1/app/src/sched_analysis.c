@@ -0,0 +1,487 @@
+/*
+ * @file
+ * @brief Response time analysis for the fixed priority task set.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <stddef.h>
+#include "sched_analysis.h"
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+/*
+ * @function schedTaskFromModel
+ *
+ * @brief Converts a task_model.h entry into the analysis representation. The
+ * 		  implicit deadline of every task is its period.
+ */
+void schedTaskFromModel(const struct task_s *task, struct schedTask *out) {
+	uint32_t wcet = 0;
+	for (int k = 0; k < 3; k++) {
+		wcet += task->exec_us[k];
+	}
+	out->name = task->t_name;
+	out->priority = task->priority;
+	out->threshold = task->threshold;
+	out->mutex = task->mutex_m;
+	out->cpu = 0;
+	out->period = (uint32_t)task->period * 1000U;
+	out->deadline = out->period;
+	out->wcet = wcet;
+	out->critical = task->exec_us[1];
+	out->criticality = task->criticality;
+	out->budget[CRIT_LO] = task->budget_us[CRIT_LO];
+	out->budget[CRIT_HI] = task->budget_us[CRIT_HI];
+	out->blocking = 0;
+	out->response = 0;
+	out->responseHi = 0;
+	out->schedulable = false;
+}
+
+/* Total utilisation of the set in parts per million */
+uint32_t schedUtilization(const struct schedTask *set, int n) {
+	uint64_t util = 0;
+	for (int i = 0; i < n; i++) {
+		util += (uint64_t)set[i].wcet * UTIL_ONE / set[i].period;
+	}
+	return (uint32_t)util;
+}
+
+/* Ceiling of a mutex: the most urgent priority among the tasks locking it */
+static int mutexCeiling(const struct schedTask *set, int n, int mutex) {
+	int ceiling = INT32_MAX;
+	for (int j = 0; j < n; j++) {
+		if (set[j].mutex == mutex && set[j].priority < ceiling) {
+			ceiling = set[j].priority;
+		}
+	}
+	return ceiling;
+}
+
+/*
+ * @function schedComputeBlocking
+ *
+ * @brief Computes the blocking term B_i of every task. Only a lower priority
+ * 		  task holding a mutex whose ceiling is at least as urgent as task i
+ * 		  can block it. With a ceiling protocol at most one such critical
+ * 		  section blocks a job; with priority inheritance every mutex can
+ * 		  block it once.
+ */
+void schedComputeBlocking(struct schedTask *set, int n, enum lockProtocol protocol) {
+	for (int i = 0; i < n; i++) {
+		uint32_t perMutex[NUM_MUTEXES] = {0};
+		uint32_t blocking = 0;
+
+		for (int j = 0; j < n; j++) {
+			if (set[j].priority <= set[i].priority || set[j].mutex < 0 ||
+				set[j].mutex >= NUM_MUTEXES) {
+				continue;
+			}
+			if (mutexCeiling(set, n, set[j].mutex) > set[i].priority) {
+				continue;
+			}
+			if (set[j].critical > perMutex[set[j].mutex]) {
+				perMutex[set[j].mutex] = set[j].critical;
+			}
+		}
+		for (int m = 0; m < NUM_MUTEXES; m++) {
+			if (protocol == LOCK_CEILING) {
+				blocking = perMutex[m] > blocking ? perMutex[m] : blocking;
+			} else {
+				blocking += perMutex[m];
+			}
+		}
+		set[i].blocking = blocking;
+	}
+}
+
+/*
+ * @function schedResponseTimeAnalysis
+ *
+ * @brief Iterates R = C_i + B_i + sum(ceil(R / T_j) * C_j) over the tasks of
+ * 		  equal or higher priority on the same core until it converges or
+ * 		  exceeds the deadline. Returns the number of tasks that can miss a
+ * 		  deadline. Blocking is taken from every core; remote blocking by
+ * 		  higher priority tasks on other cores is not modelled.
+ */
+int schedResponseTimeAnalysis(struct schedTask *set, int n, enum lockProtocol protocol) {
+	int misses = 0;
+
+	schedComputeBlocking(set, n, protocol);
+	for (int i = 0; i < n; i++) {
+		uint64_t response = (uint64_t)set[i].wcet + set[i].blocking;
+		uint64_t previous = 0;
+
+		while (response != previous && response <= set[i].deadline) {
+			previous = response;
+			response = (uint64_t)set[i].wcet + set[i].blocking;
+			for (int j = 0; j < n; j++) {
+				if (j == i || set[j].cpu != set[i].cpu || set[j].priority > set[i].priority) {
+					continue;
+				}
+				response += ((previous + set[j].period - 1) / set[j].period) * set[j].wcet;
+			}
+		}
+		set[i].response = response > UINT32_MAX ? UINT32_MAX : (uint32_t)response;
+		set[i].schedulable = response <= set[i].deadline;
+		if (!set[i].schedulable) {
+			misses++;
+		}
+	}
+	return misses;
+}
+
+/*
+ * @function schedEdfTest
+ *
+ * @brief Utilisation test for EDF with blocking (Baker): for every task k,
+ * 		  the utilisation of the tasks with a deadline no later than D_k plus
+ * 		  B_k / D_k must not exceed one. B_k is the longest critical section
+ * 		  of a task with a later deadline on a mutex also locked by a task
+ * 		  with a deadline no later than D_k, on any core. Only tasks on the
+ * 		  same core as k add utilisation. Response times are not computed.
+ * 		  Returns the number of tasks for which the test fails.
+ */
+int schedEdfTest(struct schedTask *set, int n) {
+	int misses = 0;
+
+	for (int k = 0; k < n; k++) {
+		bool shared[NUM_MUTEXES] = {false};
+		uint64_t util = 0;
+		uint32_t blocking = 0;
+
+		for (int i = 0; i < n; i++) {
+			if (set[i].cpu != set[k].cpu || set[i].deadline > set[k].deadline) {
+				continue;
+			}
+			util += (uint64_t)set[i].wcet * UTIL_ONE / set[i].period;
+			if (set[i].mutex >= 0 && set[i].mutex < NUM_MUTEXES) {
+				shared[set[i].mutex] = true;
+			}
+		}
+		for (int j = 0; j < n; j++) {
+			if (set[j].deadline > set[k].deadline && set[j].mutex >= 0 &&
+				set[j].mutex < NUM_MUTEXES && shared[set[j].mutex] &&
+				set[j].critical > blocking) {
+				blocking = set[j].critical;
+			}
+		}
+		util += (uint64_t)blocking * UTIL_ONE / set[k].deadline;
+		set[k].blocking = blocking;
+		set[k].response = 0;
+		set[k].schedulable = util <= UTIL_ONE;
+		if (!set[k].schedulable) {
+			misses++;
+		}
+	}
+	return misses;
+}
+
+/*
+ * Blocking of task i by a started job of a lower priority task whose
+ * preemption threshold is at least as urgent as task i, charged the given
+ * execution times of that task.
+ */
+static uint32_t thresholdBlocking(const struct schedTask *set, int n, int i, int mode) {
+	uint32_t blocking = 0;
+	for (int j = 0; j < n; j++) {
+		uint32_t c = mode < 0 ? set[j].wcet : set[j].budget[mode];
+		if (set[j].cpu == set[i].cpu && set[j].priority > set[i].priority &&
+			set[j].threshold <= set[i].priority && c > blocking) {
+			blocking = c;
+		}
+	}
+	return blocking;
+}
+
+bool schedHasHiTasks(const struct schedTask *set, int n) {
+	for (int i = 0; i < n; i++) {
+		if (set[i].criticality == CRIT_HI) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Interference of the higher priority tasks hp on task i in a window of length window */
+static uint64_t amcInterference(const struct schedTask *set, int n, int i, uint64_t window,
+								int level, int mode) {
+	uint64_t interference = 0;
+	for (int j = 0; j < n; j++) {
+		if (j == i || set[j].cpu != set[i].cpu || set[j].priority > set[i].priority ||
+			set[j].criticality != level) {
+			continue;
+		}
+		interference += ((window + set[j].period - 1) / set[j].period) * set[j].budget[mode];
+	}
+	return interference;
+}
+
+/*
+ * @function schedAmcResponseTime
+ *
+ * @brief Adaptive mixed criticality analysis (AMC-rtb) of the budgets in
+ * 		  task_s.budget_us. In LO mode every task is charged its LO budget:
+ * 		  R_i(LO) = C_i(LO) + B_i + sum over hp(i) of ceil(R / T_j) * C_j(LO).
+ * 		  After a switch only HI tasks run, and LO tasks can only have been
+ * 		  released before R_i(LO):
+ * 		  R_i(HI) = C_i(HI) + B_i + sum over hpH(i) of ceil(R / T_j) * C_j(HI)
+ * 		  + sum over hpL(i) of ceil(R_i(LO) / T_k) * C_k(LO).
+ * 		  A LO task must meet its deadline in LO mode, a HI task in both.
+ * 		  B_i includes a started lower priority job whose preemption
+ * 		  threshold keeps task i from preempting it, at its budget in the
+ * 		  mode analysed.
+ * 		  Returns the number of tasks that can miss a deadline.
+ */
+int schedAmcResponseTime(struct schedTask *set, int n, enum lockProtocol protocol) {
+	int misses = 0;
+
+	schedComputeBlocking(set, n, protocol);
+	for (int i = 0; i < n; i++) {
+		uint64_t base = MAX(set[i].blocking, thresholdBlocking(set, n, i, CRIT_LO));
+		uint64_t lo = base + set[i].budget[CRIT_LO];
+		uint64_t hi = 0;
+		uint64_t previous = 0;
+
+		while (lo != previous && lo <= set[i].deadline) {
+			previous = lo;
+			lo = base + set[i].budget[CRIT_LO] +
+				 amcInterference(set, n, i, previous, CRIT_LO, CRIT_LO) +
+				 amcInterference(set, n, i, previous, CRIT_HI, CRIT_LO);
+		}
+		set[i].response = lo > UINT32_MAX ? UINT32_MAX : (uint32_t)lo;
+		set[i].schedulable = lo <= set[i].deadline;
+		if (set[i].criticality == CRIT_HI && set[i].schedulable) {
+			uint64_t carry = amcInterference(set, n, i, lo, CRIT_LO, CRIT_LO);
+
+			base = MAX(set[i].blocking, thresholdBlocking(set, n, i, CRIT_HI));
+			hi = base + set[i].budget[CRIT_HI] + carry;
+			previous = 0;
+			while (hi != previous && hi <= set[i].deadline) {
+				previous = hi;
+				hi = base + set[i].budget[CRIT_HI] + carry +
+					 amcInterference(set, n, i, previous, CRIT_HI, CRIT_HI);
+			}
+			set[i].schedulable = hi <= set[i].deadline;
+		}
+		set[i].responseHi = hi > UINT32_MAX ? UINT32_MAX : (uint32_t)hi;
+		if (!set[i].schedulable) {
+			misses++;
+		}
+	}
+	return misses;
+}
+
+bool schedHasThresholds(const struct schedTask *set, int n) {
+	for (int i = 0; i < n; i++) {
+		if (set[i].threshold != set[i].priority) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * @function schedThresholdResponseTime
+ *
+ * @brief Response time analysis with preemption thresholds (Wang and
+ * 		  Saksena). A job waits for its start at its priority and then runs
+ * 		  at its threshold, so a started job of a lower priority task with a
+ * 		  threshold at least as urgent as task i blocks it like a critical
+ * 		  section. For every job q of the level-i busy period:
+ * 		  S_q = B_i + (q - 1) * C_i + sum over hp(i) of (1 + floor(S_q / T_j)) * C_j
+ * 		  F_q = S_q + C_i + sum over the tasks more urgent than the threshold
+ * 		  of (ceil(F_q / T_j) - 1 - floor(S_q / T_j)) * C_j
+ * 		  and R_i is the largest F_q - (q - 1) * T_i. With every threshold
+ * 		  equal to the priority this is the plain response time analysis.
+ * 		  Returns the number of tasks that can miss a deadline.
+ */
+int schedThresholdResponseTime(struct schedTask *set, int n, enum lockProtocol protocol) {
+	int misses = 0;
+
+	schedComputeBlocking(set, n, protocol);
+	for (int i = 0; i < n; i++) {
+		uint64_t horizon = (uint64_t)set[i].period * SCHED_MAX_JOBS;
+		uint64_t blocking = MAX(set[i].blocking, thresholdBlocking(set, n, i, -1));
+		uint64_t busy, previous = 0, worst = 0;
+		uint32_t jobs;
+
+		/* Level-i busy period, the jobs of task i in it are analysed */
+		busy = blocking + set[i].wcet;
+		while (busy != previous && busy <= horizon) {
+			previous = busy;
+			busy = blocking;
+			for (int j = 0; j < n; j++) {
+				if (set[j].cpu == set[i].cpu && (j == i || set[j].priority <= set[i].priority)) {
+					busy += ((previous + set[j].period - 1) / set[j].period) * set[j].wcet;
+				}
+			}
+		}
+		jobs = busy > horizon ? SCHED_MAX_JOBS : (uint32_t)((busy + set[i].period - 1) / set[i].period);
+		for (uint32_t q = 1; q <= jobs && worst <= set[i].deadline; q++) {
+			uint64_t start = blocking + (q - 1) * set[i].wcet, finish;
+
+			/* Iterated at least once, the higher priority jobs released with it delay the start */
+			do {
+				previous = start;
+				start = blocking + (q - 1) * set[i].wcet;
+				for (int j = 0; j < n; j++) {
+					if (j != i && set[j].cpu == set[i].cpu && set[j].priority <= set[i].priority) {
+						start += (1 + previous / set[j].period) * set[j].wcet;
+					}
+				}
+			} while (start != previous && start <= horizon);
+			finish = start + set[i].wcet;
+			previous = 0;
+			while (finish != previous && finish <= horizon) {
+				previous = finish;
+				finish = start + set[i].wcet;
+				for (int j = 0; j < n; j++) {
+					uint64_t arrivals = (previous + set[j].period - 1) / set[j].period;
+					uint64_t before = 1 + start / set[j].period;
+
+					if (j != i && set[j].cpu == set[i].cpu && set[j].priority < set[i].threshold &&
+						arrivals > before) {
+						finish += (arrivals - before) * set[j].wcet;
+					}
+				}
+			}
+			if (finish - (q - 1) * set[i].period > worst) {
+				worst = finish - (q - 1) * set[i].period;
+			}
+		}
+		if (busy > horizon) {
+			worst = UINT32_MAX;
+		}
+		set[i].blocking = (uint32_t)blocking;
+		set[i].response = worst > UINT32_MAX ? UINT32_MAX : (uint32_t)worst;
+		set[i].schedulable = worst <= set[i].deadline;
+		if (!set[i].schedulable) {
+			misses++;
+		}
+	}
+	return misses;
+}
+
+/* Misses of the set with its thresholds, under AMC-rtb too when it has HI tasks */
+static int thresholdMisses(struct schedTask *set, int n, enum lockProtocol protocol) {
+	int misses = schedHasHiTasks(set, n) ? schedAmcResponseTime(set, n, protocol) : 0;
+	return misses + schedThresholdResponseTime(set, n, protocol);
+}
+
+/*
+ * @function schedAssignThresholds
+ *
+ * @brief Searches the largest preemption thresholds that keep the set
+ * 		  schedulable. Starting from thresholds equal to the priorities, the
+ * 		  tasks in order of decreasing urgency have their threshold raised
+ * 		  one priority level of the set at a time for as long as the whole
+ * 		  set still passes schedThresholdResponseTime(), and the AMC-rtb
+ * 		  analysis of its budgets when it has HI tasks. Larger thresholds
+ * 		  mean fewer tasks that can preempt a started job. The thresholds
+ * 		  are left in set; returns the number of tasks that miss a deadline
+ * 		  with them, which is nonzero only if the set fails without any.
+ */
+int schedAssignThresholds(struct schedTask *set, int n, enum lockProtocol protocol) {
+	bool done[SCHED_MAX_TASKS] = {false};
+	int misses;
+
+	n = n > SCHED_MAX_TASKS ? SCHED_MAX_TASKS : n;
+	for (int i = 0; i < n; i++) {
+		set[i].threshold = set[i].priority;
+	}
+	misses = thresholdMisses(set, n, protocol);
+	if (misses) {
+		return misses;
+	}
+	for (int k = 0; k < n; k++) {
+		/* The most urgent task not yet handled goes next */
+		int i = -1;
+		for (int j = 0; j < n; j++) {
+			if (!done[j] && (i < 0 || set[j].priority < set[i].priority)) {
+				i = j;
+			}
+		}
+		done[i] = true;
+		while (1) {
+			/* The next more urgent priority level of a task on the same core */
+			int level = INT32_MIN;
+			int saved = set[i].threshold;
+
+			for (int j = 0; j < n; j++) {
+				if (set[j].cpu == set[i].cpu && set[j].priority < saved && set[j].priority > level) {
+					level = set[j].priority;
+				}
+			}
+			if (level == INT32_MIN) {
+				break;
+			}
+			set[i].threshold = level;
+			if (thresholdMisses(set, n, protocol)) {
+				set[i].threshold = saved;
+				break;
+			}
+		}
+	}
+	return thresholdMisses(set, n, protocol);
+}
+
+/*
+ * @function schedPartition
+ *
+ * @brief Places every task on one of cpus cores by worst-fit decreasing
+ * 		  utilisation: tasks in order of decreasing utilisation go to the
+ * 		  least loaded core that still passes a utilisation test, the
+ * 		  hyperbolic bound prod(U_i + 1) <= 2 for fixed priorities or
+ * 		  sum(U_i) <= 1 for EDF. Worst-fit spreads the load, which keeps
+ * 		  response times short on every core. A task that fits nowhere goes
+ * 		  to the least loaded core. Returns the number of such tasks.
+ */
+int schedPartition(struct schedTask *set, int n, int cpus, enum schedPolicy policy) {
+	uint64_t load[SCHED_MAX_CPUS];		// sum of U_i, parts per million
+	uint64_t product[SCHED_MAX_CPUS];	// prod(U_i + 1), parts per million
+	bool placed[SCHED_MAX_TASKS] = {false};
+	int misfits = 0;
+
+	cpus = cpus < 1 ? 1 : (cpus > SCHED_MAX_CPUS ? SCHED_MAX_CPUS : cpus);
+	n = n > SCHED_MAX_TASKS ? SCHED_MAX_TASKS : n;
+	for (int c = 0; c < cpus; c++) {
+		load[c] = 0;
+		product[c] = UTIL_ONE;
+	}
+	for (int k = 0; k < n; k++) {
+		/* The unplaced task with the highest utilisation goes next */
+		int i = -1;
+		uint64_t util = 0;
+		for (int j = 0; j < n; j++) {
+			uint64_t u = (uint64_t)set[j].wcet * UTIL_ONE / set[j].period;
+			if (!placed[j] && (i < 0 || u > util)) {
+				i = j;
+				util = u;
+			}
+		}
+		int target = -1;
+		int lightest = 0;
+		for (int c = 0; c < cpus; c++) {
+			bool fits = policy == POLICY_EDF ? load[c] + util <= UTIL_ONE :
+						product[c] * (UTIL_ONE + util) / UTIL_ONE <= 2 * UTIL_ONE;
+			if (fits && (target < 0 || load[c] < load[target])) {
+				target = c;
+			}
+			if (load[c] < load[lightest]) {
+				lightest = c;
+			}
+		}
+		if (target < 0) {
+			target = lightest;
+			misfits++;
+		}
+		set[i].cpu = target;
+		placed[i] = true;
+		load[target] += util;
+		product[target] = product[target] * (UTIL_ONE + util) / UTIL_ONE;
+	}
+	return misfits;
+}
@@ -0,0 +1,62 @@
+#ifndef __SCHED_ANALYSIS_H__
+#define __SCHED_ANALYSIS_H__
+
+/*
+ * Fixed priority schedulability analysis of the task set in task_model.h.
+ * Plain C without any Zephyr dependency so that the same code runs in the
+ * host side build check and on the target.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "task_model.h"
+
+#define UTIL_ONE 1000000	// utilisation of 1.0 in parts per million
+#define SCHED_MAX_CPUS 16	// cores considered by schedPartition()
+#define SCHED_MAX_TASKS 32	// tasks considered by schedPartition()
+#define SCHED_MAX_JOBS 64	// jobs of a busy period before a task is deemed unschedulable
+
+/* Scheduling policy the task set runs under */
+enum schedPolicy {
+	POLICY_RM,			// fixed priorities from task_s.priority
+	POLICY_EDF,			// earliest deadline first
+};
+
+/* Locking protocol used for the mutex_m critical sections */
+enum lockProtocol {
+	LOCK_INHERITANCE,	// k_mutex, priority inheritance
+	LOCK_CEILING,		// priority ceiling
+};
+
+struct schedTask {
+	const char *name;
+	int priority;		// zephyr priority, lower value is more urgent
+	int threshold;		// preemption threshold, at least as urgent as priority
+	int mutex;			// mutex id locked by the task, -1 for none
+	int cpu;			// core the task is placed on
+	uint32_t period;	// T_i in microseconds
+	uint32_t deadline;	// D_i in microseconds
+	uint32_t wcet;		// C_i in microseconds
+	uint32_t critical;	// longest critical section in microseconds
+	int criticality;	// CRIT_LO or CRIT_HI
+	uint32_t budget[2];	// C_i(LO) and C_i(HI) in microseconds
+	/* Results of the analysis */
+	uint32_t blocking;	// B_i in microseconds
+	uint32_t response;	// R_i in microseconds
+	uint32_t responseHi;	// R_i after a switch to HI mode, HI tasks only
+	bool schedulable;
+};
+
+void schedTaskFromModel(const struct task_s *task, struct schedTask *out);
+uint32_t schedUtilization(const struct schedTask *set, int n);
+void schedComputeBlocking(struct schedTask *set, int n, enum lockProtocol protocol);
+int schedResponseTimeAnalysis(struct schedTask *set, int n, enum lockProtocol protocol);
+int schedEdfTest(struct schedTask *set, int n);
+bool schedHasHiTasks(const struct schedTask *set, int n);
+int schedAmcResponseTime(struct schedTask *set, int n, enum lockProtocol protocol);
+bool schedHasThresholds(const struct schedTask *set, int n);
+int schedThresholdResponseTime(struct schedTask *set, int n, enum lockProtocol protocol);
+int schedAssignThresholds(struct schedTask *set, int n, enum lockProtocol protocol);
+int schedPartition(struct schedTask *set, int n, int cpus, enum schedPolicy policy);
+
+#endif // __SCHED_ANALYSIS_H__
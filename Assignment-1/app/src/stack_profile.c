@@ -0,0 +1,89 @@
+/*
+ * @file
+ * @brief Stack high-watermark profile and the "stacks" shell command.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <string.h>
+#include "task_pool.h"
+#include "stack_table.h"
+#include "stack_profile.h"
+
+/* Peak usage of every slot over all runs since boot, in bytes */
+struct stackPeak {
+	size_t size;	// size the thread was created with
+	size_t used;
+	uint32_t runs;
+};
+
+static struct stackPeak peaks[MAX_TASKS];
+
+/*
+ * @function stackProfileRecord
+ *
+ * @brief Called for every task thread once it has been joined. Keeps the
+ * 		  highest usage of the slot; a stack that was used up to its last
+ * 		  byte may have overflowed and is reported as such. The stack of a
+ * 		  task_model.h slot is sized for its own task only, so a run of any
+ * 		  other task there is not counted.
+ */
+void stackProfileRecord(int slot, const struct k_thread *thread, size_t size) {
+	size_t unused;
+
+	if (slot < NUM_THREADS && taskPoolModelIndex(slot) != slot) {
+		return;
+	}
+	if (k_thread_stack_space_get(thread, &unused)) {
+		return;
+	}
+	peaks[slot].size = size;
+	peaks[slot].used = MAX(peaks[slot].used, size - unused);
+	peaks[slot].runs++;
+}
+
+/* Size for a peak usage: the margin added, rounded up to STACK_ALIGN */
+static size_t suggestedSize(size_t used) {
+	size_t size = used + used * STACK_MARGIN / 100;
+	return ROUND_UP(MAX(size, (size_t)STACK_ALIGN), STACK_ALIGN);
+}
+
+/*
+ * This is the entry point function for the root shell command "stacks". It
+ * prints the peak stack usage of every slot run so far and a replacement
+ * for src/stack_table.h. Slots never run keep their current size; the spare
+ * slots share one size, taken from the largest of their peaks.
+ */
+static int stacksCommand(const struct shell *shell, size_t argc, char **argv) {
+	static const size_t current[NUM_THREADS] = {
+		TASK0_STACK_SIZE, TASK1_STACK_SIZE, TASK2_STACK_SIZE, TASK3_STACK_SIZE,
+	};
+	size_t spareUsed = 0;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+	for (int i = 0; i < MAX_TASKS; i++) {
+		const struct task_s *task = taskPoolGet(i);
+
+		if (!peaks[i].runs) {
+			continue;
+		}
+		shell_print(shell, "slot %d (%s): peak %zu of %zu bytes over %u runs%s", i,
+					task ? task->t_name : "free", peaks[i].used, peaks[i].size, peaks[i].runs,
+					peaks[i].used >= peaks[i].size ? ", OVERFLOWED" : "");
+		if (i >= NUM_THREADS) {
+			spareUsed = MAX(spareUsed, peaks[i].used);
+		}
+	}
+	shell_print(shell, "/* Peak stack usage plus %d%%, from the \"stacks\" shell command */",
+				STACK_MARGIN);
+	for (int i = 0; i < NUM_THREADS; i++) {
+		shell_print(shell, "#define TASK%d_STACK_SIZE %zu", i,
+					peaks[i].runs ? suggestedSize(peaks[i].used) : current[i]);
+	}
+	shell_print(shell, "#define SPARE_STACK_SIZE %zu",
+				spareUsed ? suggestedSize(spareUsed) : (size_t)SPARE_STACK_SIZE);
+	return 0;
+}
+SHELL_CMD_REGISTER(stacks, NULL, "Peak stack usage of the tasks and right-sized stacks", stacksCommand);
@@ -0,0 +1,18 @@
+#ifndef __STACK_PROFILE_H__
+#define __STACK_PROFILE_H__
+
+/*
+ * Stack high-watermark profile of the task threads. Stacks are filled with
+ * a known pattern when a thread is created (CONFIG_INIT_STACKS), so after a
+ * run the untouched part of every stack gives its peak usage. The "stacks"
+ * shell command turns the peaks into a stack_table.h.
+ */
+
+#include <zephyr.h>
+
+#define STACK_MARGIN 25	// percent added to the peak usage
+#define STACK_ALIGN 64	// suggested sizes are rounded up to this
+
+void stackProfileRecord(int slot, const struct k_thread *thread, size_t size);
+
+#endif // __STACK_PROFILE_H__
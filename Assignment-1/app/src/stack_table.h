@@ -0,0 +1,17 @@
+#ifndef __STACK_TABLE_H__
+#define __STACK_TABLE_H__
+
+/*
+ * Stack sizes of the task threads in bytes: one per task_model.h task and
+ * one shared by the spare slots that tasks added at runtime use. The
+ * "stacks" shell command prints a replacement for this file from the peak
+ * usage of the runs so far, with STACK_MARGIN percent added.
+ */
+
+#define TASK0_STACK_SIZE 1024
+#define TASK1_STACK_SIZE 1024
+#define TASK2_STACK_SIZE 1024
+#define TASK3_STACK_SIZE 1024
+#define SPARE_STACK_SIZE 1024
+
+#endif // __STACK_TABLE_H__
@@ -0,0 +1,83 @@
+/*
+ * @file
+ * @brief Context switch and preemption counters of the task threads.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include "task_pool.h"
+#include "switch_count.h"
+
+/* Written by the switch hooks with interrupts locked, read after the run */
+static struct k_thread *counted[MAX_TASKS];
+static volatile bool inJob[MAX_TASKS];
+static uint32_t switches[MAX_TASKS];
+static uint32_t preemptions[MAX_TASKS];
+/* Cycle at which the thread of a slot was last switched in, while it runs */
+static volatile uint32_t switchedIn[MAX_TASKS];
+static volatile bool onCpu[MAX_TASKS];
+
+/* Starts counting the switches into the thread of a slot for a run */
+void switchCountStart(int slot, struct k_thread *thread) {
+	switches[slot] = 0;
+	preemptions[slot] = 0;
+	inJob[slot] = false;
+	onCpu[slot] = false;
+	counted[slot] = thread;
+}
+
+/* Called by the task thread when it starts and when it ends a job */
+void switchCountJob(int slot, bool started) {
+	inJob[slot] = started;
+}
+
+uint32_t switchCountSwitches(int slot) {
+	return switches[slot];
+}
+
+uint32_t switchCountPreemptions(int slot) {
+	return preemptions[slot];
+}
+
+/*
+ * Cycles the thread has run since it was last switched in, zero when it is
+ * not running. The runtime stats of a thread only grow when it is switched
+ * out, so this is the slice they do not hold yet.
+ */
+uint32_t switchCountRunningCycles(struct k_thread *thread) {
+	for (int i = 0; i < MAX_TASKS; i++) {
+		if (counted[i] == thread) {
+			return onCpu[i] ? k_cycle_get_32() - switchedIn[i] : 0;
+		}
+	}
+	return 0;
+}
+
+#ifdef CONFIG_TRACING_USER
+/* Called by the kernel whenever a thread is switched in */
+void sys_trace_thread_switched_in_user(struct k_thread *thread) {
+	for (int i = 0; i < MAX_TASKS; i++) {
+		if (counted[i] == thread) {
+			switchedIn[i] = k_cycle_get_32();
+			onCpu[i] = true;
+#ifdef CONFIG_APP_COUNT_SWITCHES
+			switches[i]++;
+			if (inJob[i]) {
+				preemptions[i]++;
+			}
+#endif
+			return;
+		}
+	}
+}
+
+/* Called by the kernel whenever a thread is switched out */
+void sys_trace_thread_switched_out_user(struct k_thread *thread) {
+	for (int i = 0; i < MAX_TASKS; i++) {
+		if (counted[i] == thread) {
+			onCpu[i] = false;
+			return;
+		}
+	}
+}
+#endif
@@ -0,0 +1,21 @@
+#ifndef __SWITCH_COUNT_H__
+#define __SWITCH_COUNT_H__
+
+/*
+ * Context switch counters of the task threads, fed by the user tracing
+ * hooks of the kernel (CONFIG_TRACING_USER). A switch into a thread whose
+ * job had already started resumes a preempted job and counts as a
+ * preemption. The same hooks keep the switch in cycle of every task
+ * thread, for the slice its runtime stats do not hold yet. Without the
+ * hooks every counter and every slice reads zero.
+ */
+
+#include <zephyr.h>
+
+void switchCountStart(int slot, struct k_thread *thread);
+void switchCountJob(int slot, bool started);
+uint32_t switchCountSwitches(int slot);
+uint32_t switchCountPreemptions(int slot);
+uint32_t switchCountRunningCycles(struct k_thread *thread);
+
+#endif // __SWITCH_COUNT_H__
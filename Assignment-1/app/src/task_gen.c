@@ -0,0 +1,98 @@
+/*
+ * @file
+ * @brief UUniFast task set generator of the schedulability benchmark.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "task_pool.h"
+#include "task_gen.h"
+
+/* Periods in ms, all dividing TASK_GEN_HYPERPERIOD and a 10 ms tick */
+static const int genPeriods[] = {20, 40, 50, 100, 200, 250, 500, 1000};
+
+static uint32_t genState = 1;
+
+/* xorshift32, enough for task parameters and identical on host and target */
+static uint32_t genRandom(void) {
+	genState ^= genState << 13;
+	genState ^= genState >> 17;
+	genState ^= genState << 5;
+	return genState;
+}
+
+/* Restarts the generator, the same seed gives the same sets */
+void taskGenSeed(uint32_t seed) {
+	genState = seed ? seed : 1;
+}
+
+/*
+ * @function taskGenUUniFast
+ *
+ * @brief Splits the total utilisation util (UTIL_ONE = 1.0) over n tasks,
+ * 		  uniformly over all splits (Bini and Buttazzo). The factor r^(1/k)
+ * 		  of the algorithm is drawn as the largest of k uniform numbers,
+ * 		  which has the same distribution and needs no floating point.
+ */
+void taskGenUUniFast(int n, uint32_t util, uint32_t *u) {
+	uint32_t sum = util;
+
+	for (int i = 0; i < n - 1; i++) {
+		uint32_t factor = 0;
+
+		for (int k = 0; k < n - 1 - i; k++) {
+			uint32_t r = genRandom() % UTIL_ONE;
+			if (r > factor) {
+				factor = r;
+			}
+		}
+		uint32_t next = (uint64_t)sum * factor / UTIL_ONE;
+		u[i] = sum - next;
+		sum = next;
+	}
+	u[n - 1] = sum;
+}
+
+/*
+ * @function taskGenSet
+ *
+ * @brief Fills tasks with a random set of n tasks of total utilisation
+ * 		  util, n at most MAX_TASKS. Priorities are rate monotonic, a
+ * 		  tenth of every job in its middle holds one of the mutexes, and
+ * 		  the budgets are twice the execution time so that budget
+ * 		  enforcement never cuts a job that runs as modelled.
+ */
+void taskGenSet(int n, uint32_t util, struct task_s *tasks) {
+	uint32_t u[MAX_TASKS];
+
+	taskGenUUniFast(n, util, u);
+	memset(tasks, 0, n * sizeof(*tasks));
+	for (int i = 0; i < n; i++) {
+		struct task_s *task = &tasks[i];
+		int c;
+
+		snprintf(task->t_name, sizeof(task->t_name), "gen%d", i);
+		task->period = genPeriods[genRandom() % (sizeof(genPeriods) / sizeof(genPeriods[0]))];
+		c = (int)((uint64_t)u[i] * task->period * 1000 / UTIL_ONE);
+		c = c > 0 ? c : 1;
+		task->exec_us[0] = c / 2;
+		task->exec_us[1] = c / 10;
+		task->exec_us[2] = c - c / 2 - c / 10;
+		task->mutex_m = i % NUM_MUTEXES;
+		task->overrun = OVERRUN_CONTINUE;
+		task->criticality = CRIT_LO;
+		task->budget_us[CRIT_LO] = 2 * c;
+		task->budget_us[CRIT_HI] = 2 * c;
+	}
+	/* Rate monotonic priorities from 1, ties by index */
+	for (int i = 0; i < n; i++) {
+		tasks[i].priority = 1;
+		for (int k = 0; k < n; k++) {
+			if (tasks[k].period < tasks[i].period || (tasks[k].period == tasks[i].period && k < i)) {
+				tasks[i].priority++;
+			}
+		}
+		tasks[i].threshold = tasks[i].priority;
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef __TASK_GEN_H__
+#define __TASK_GEN_H__
+
+/*
+ * Random periodic task sets for the schedulability benchmark. Utilisations
+ * are drawn with UUniFast, periods from a table that divides
+ * TASK_GEN_HYPERPERIOD, and a seed makes every sweep reproducible. Plain C
+ * without any Zephyr dependency, like sched_analysis.c.
+ */
+
+#include <stdint.h>
+#include "task_model.h"
+
+#define TASK_GEN_HYPERPERIOD 1000	// ms, every generated period divides it
+#define TASK_GEN_UTIL_MIN 50		// first utilisation of a sweep, percent
+#define TASK_GEN_UTIL_MAX 100		// last utilisation of a sweep, percent
+#define TASK_GEN_UTIL_STEP 5		// percent
+
+void taskGenSeed(uint32_t seed);
+void taskGenUUniFast(int n, uint32_t util, uint32_t *u);
+void taskGenSet(int n, uint32_t util, struct task_s *tasks);
+
+#endif // __TASK_GEN_H__
@@ -0,0 +1,12 @@
+/*
+ * @file
+ * @brief Task set table of the periodic task framework.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include "task_model.h"
+
+/* Const so that the table is placed in flash and not copied into RAM. */
+const struct task_s threads[NUM_THREADS] = {THREAD0, THREAD1, THREAD2, THREAD3};
+const struct mode_s modes[NUM_MODES] = {MODE0, MODE1};
+const struct chain_s chains[NUM_CHAINS] = {CHAIN0};
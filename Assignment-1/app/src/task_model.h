@@ -2,28 +2,98 @@
 #define __TASK_MODEL_H__
 
 /*
- * 
+ * Task set of the periodic task framework. The table itself lives in
+ * task_model.c as a const array (kept in flash) and is also compiled into
+ * the host side schedulability check (tools/sched_check.c), so this header
+ * must not depend on any Zephyr header. The segment execution times come
+ * from wcet_table.h, which the "wcet" shell command regenerates.
  */
 
+#include "wcet_table.h"
+
 #define NUM_MUTEXES 3		// number of mutexes
 #define NUM_THREADS	4		// number of threads
 #define TOTAL_TIME 4000  	// total execution time in milliseconds
 
+/* What happens to a task whose job is still running at its deadline */
+#define OVERRUN_CONTINUE 0	// the late job finishes, the next release is queued
+#define OVERRUN_SKIP 1		// the late job finishes, releases are skipped until it does
+#define OVERRUN_ABORT 2		// the late job is abandoned at its next segment boundary
+
+/* Criticality of a task, and the criticality mode of the system */
+#define CRIT_LO 0
+#define CRIT_HI 1
+
+/* Workload kernel of a compute segment, see workload.c */
+#define KERNEL_ALU 0		// register bound decrement loop, no memory traffic
+#define KERNEL_STREAM 1		// sequential read and write back of the working set
+#define KERNEL_CHASE 2		// dependent loads along a random cycle through the working set
+#define KERNEL_THRASH 3		// read and write back of one word per cache line
+#define KERNEL_MATH 4		// floating point multiply-accumulate over the working set
+#define NUM_KERNELS 5
+
 struct task_s
 {
 	char t_name[32]; 	// task name
 	int priority; 		// priority of the task
 	int period; 		// period for periodic task in milliseconds
-	int loop_iter[3]; 	// loop iterations for compute_1, compute_2 and compute_3
+	int exec_us[3]; 	// execution time of compute_1, compute_2 and compute_3 in microseconds
 	int mutex_m; 		// the mutex id to be locked and unlocked by the task
+	int overrun; 		// overrun policy, one of OVERRUN_*
+	int criticality; 	// CRIT_LO or CRIT_HI
+	int budget_us[2]; 	// execution budget per job in LO and in HI mode in microseconds
+	int reserve_us; 	// bandwidth server budget per period in microseconds, 0 for none
+	int threshold; 		// preemption threshold, the priority a started job runs at
+	int kernel[3]; 		// workload kernel of compute_1, compute_2 and compute_3, one of KERNEL_*
+	int working_set; 	// bytes the memory kernels of the task touch
 };
 
-#define THREAD0 {"task00", 2, 50, {400000, 400000, 400000}, 1}
-#define THREAD1 {"task11", 3, 160, {800000, 900000, 800000}, 0}
-#define THREAD2 {"task22", 4, 220, {200000, 2000000, 400000}, 1}
-#define THREAD3 {"task33", 5, 360, {200000, 2000000, 400000}, 2}
+/*
+ * The segment times of wcet_table.h were measured with the ALU kernel; a
+ * task switched to another kernel needs a new "wcet" measurement.
+ */
+#define ALU_ONLY {KERNEL_ALU, KERNEL_ALU, KERNEL_ALU}
+
+#define THREAD0 {"task00", 2, 50, TASK0_EXEC_US, 1, OVERRUN_SKIP, CRIT_HI, {12500, 18000}, 0, 2, ALU_ONLY, 0}
+#define THREAD1 {"task11", 3, 160, TASK1_EXEC_US, 0, OVERRUN_CONTINUE, CRIT_LO, {25500, 25500}, 0, 2, ALU_ONLY, 0}
+#define THREAD2 {"task22", 4, 220, TASK2_EXEC_US, 1, OVERRUN_CONTINUE, CRIT_HI, {26500, 36000}, 0, 3, ALU_ONLY, 0}
+#define THREAD3 {"task33", 5, 360, TASK3_EXEC_US, 2, OVERRUN_ABORT, CRIT_LO, {26500, 26500}, 0, 2, ALU_ONLY, 0}
+
+
+/*
+ * Operating modes. Every mode runs a subset of the tasks above, and the
+ * runtime can switch between modes without stopping the task threads.
+ */
+#define NUM_MODES 2
+
+struct mode_s
+{
+	char m_name[16]; 	// mode name
+	unsigned int tasks; // bit i is set when threads[i] runs in this mode
+};
+
+#define MODE0 {"normal", 0xf}
+#define MODE1 {"degraded", 0x3}
+
+/*
+ * Cause-effect chains. The first task of a chain samples an input, every
+ * following task works on the newest output of the task before it, and the
+ * last one acts on the result. Entries of tasks are indices into threads[].
+ */
+#define NUM_CHAINS 1
+#define MAX_CHAIN_TASKS 4
+
+struct chain_s
+{
+	char c_name[16];				// chain name
+	int length;						// number of tasks, at least 2
+	int tasks[MAX_CHAIN_TASKS];		// from the input task to the output task
+};
 
+#define CHAIN0 {"control", 3, {0, 1, 2}}
 
-struct task_s threads[NUM_THREADS]={THREAD0, THREAD1, THREAD2, THREAD3};
+extern const struct task_s threads[NUM_THREADS];
+extern const struct mode_s modes[NUM_MODES];
+extern const struct chain_s chains[NUM_CHAINS];
 
 #endif // __TASK_MODEL_H__
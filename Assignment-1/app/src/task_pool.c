@@ -0,0 +1,220 @@
+/*
+ * @file
+ * @brief Runtime task set with admission control.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include "task_pool.h"
+
+static struct task_s taskSlots[MAX_TASKS];
+static bool slotUsed[MAX_TASKS];
+
+/* Loads the task_model.h set into the first slots and frees the others */
+void taskPoolInit(void) {
+	for (int i = 0; i < MAX_TASKS; i++) {
+		slotUsed[i] = i < NUM_THREADS;
+		if (slotUsed[i]) {
+			taskSlots[i] = threads[i];
+		}
+	}
+}
+
+/* The task in a slot, NULL when the slot is free */
+const struct task_s *taskPoolGet(int slot) {
+	if (slot < 0 || slot >= MAX_TASKS || !slotUsed[slot]) {
+		return NULL;
+	}
+	return &taskSlots[slot];
+}
+
+/*
+ * First used slot at or after slot, MAX_TASKS when there is none. Loops over
+ * the task set are written as
+ * for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)).
+ */
+int taskPoolNext(int slot) {
+	while (slot < MAX_TASKS && !slotUsed[slot]) {
+		slot++;
+	}
+	return slot;
+}
+
+int taskPoolCount(void) {
+	int count = 0;
+	for (int i = 0; i < MAX_TASKS; i++) {
+		count += slotUsed[i];
+	}
+	return count;
+}
+
+/* Slot of the task with the given name, -ENOENT if there is none */
+int taskPoolFind(const char *name) {
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		if (!strncmp(taskSlots[i].t_name, name, sizeof(taskSlots[i].t_name))) {
+			return i;
+		}
+	}
+	return -ENOENT;
+}
+
+/* Index of the slot's task in task_model.h, -1 if it was added at runtime */
+int taskPoolModelIndex(int slot) {
+	if (slot >= NUM_THREADS || !taskPoolGet(slot) ||
+		strncmp(taskSlots[slot].t_name, threads[slot].t_name, sizeof(threads[slot].t_name))) {
+		return -1;
+	}
+	return slot;
+}
+
+/*
+ * Mask of the used slots that run in a mode: the task_model.h tasks the mode
+ * lists and every task added at runtime.
+ */
+uint32_t taskPoolModeSlots(int mode) {
+	uint32_t mask = 0;
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		int model = taskPoolModelIndex(i);
+		if (model < 0 || (modes[mode].tasks & (1U << model))) {
+			mask |= 1U << i;
+		}
+	}
+	return mask;
+}
+
+/*
+ * @function taskPoolAnalyse
+ *
+ * @brief Runs the schedulability analysis of the slots of the pool in
+ * 		  slotMask, plus candidate when it is not NULL, under the given policy with the ceiling protocol
+ * 		  the runtime uses. With more than one cpu the set is partitioned
+ * 		  first. The analysed tasks are returned in set, with the slot of
+ * 		  each in slots (-1 for the candidate), and their number in n.
+ * 		  Returns the number of tasks that can miss a deadline.
+ */
+int taskPoolAnalyse(const struct task_s *candidate, uint32_t slotMask, enum schedPolicy policy,
+					int cpus, struct schedTask *set, int *slots, int *n) {
+	int count = 0;
+
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		if (!(slotMask & (1U << i))) {
+			continue;
+		}
+		schedTaskFromModel(&taskSlots[i], &set[count]);
+		slots[count++] = i;
+	}
+	if (candidate) {
+		schedTaskFromModel(candidate, &set[count]);
+		slots[count++] = -1;
+	}
+	*n = count;
+	if (cpus > 1) {
+		schedPartition(set, count, cpus, policy);
+	}
+	if (policy == POLICY_EDF) {
+		return schedEdfTest(set, count);
+	}
+	return (schedHasThresholds(set, count) ? schedThresholdResponseTime(set, count, LOCK_CEILING) :
+			schedResponseTimeAnalysis(set, count, LOCK_CEILING)) +
+		   (schedHasHiTasks(set, count) ? schedAmcResponseTime(set, count, LOCK_CEILING) : 0);
+}
+
+static bool isValidTask(const struct task_s *task) {
+	return task->period > 0 && task->mutex_m >= 0 && task->mutex_m < NUM_MUTEXES &&
+		   task->exec_us[0] >= 0 && task->exec_us[1] >= 0 && task->exec_us[2] >= 0 &&
+		   task->overrun >= OVERRUN_CONTINUE && task->overrun <= OVERRUN_ABORT &&
+		   task->criticality >= CRIT_LO && task->criticality <= CRIT_HI &&
+		   task->budget_us[CRIT_LO] > 0 && task->budget_us[CRIT_HI] >= task->budget_us[CRIT_LO] &&
+		   task->reserve_us >= 0 && task->threshold >= 0 && task->threshold <= task->priority &&
+		   task->kernel[0] >= 0 && task->kernel[0] < NUM_KERNELS &&
+		   task->kernel[1] >= 0 && task->kernel[1] < NUM_KERNELS &&
+		   task->kernel[2] >= 0 && task->kernel[2] < NUM_KERNELS && task->working_set >= 0;
+}
+
+/*
+ * @function taskPoolAdd
+ *
+ * @brief Admits a task into a free slot. A task_model.h task goes back to
+ * 		  its own slot, whose stack is sized for it, and any other task to a
+ * 		  spare slot. The task is rejected when its parameters are invalid
+ * 		  (-EINVAL), its name is taken (-EEXIST), no such slot is free
+ * 		  (-ENOMEM) or the set including it can miss a deadline (-EDEADLK).
+ * 		  Returns the slot on success.
+ */
+int taskPoolAdd(const struct task_s *task, enum schedPolicy policy, int cpus) {
+	struct schedTask set[MAX_TASKS + 1];
+	int slots[MAX_TASKS + 1];
+	int n, slot;
+
+	if (!isValidTask(task)) {
+		return -EINVAL;
+	}
+	if (taskPoolFind(task->t_name) >= 0) {
+		return -EEXIST;
+	}
+	slot = NUM_THREADS;
+	for (int i = 0; i < NUM_THREADS; i++) {
+		if (!slotUsed[i] &&
+			!strncmp(task->t_name, threads[i].t_name, sizeof(threads[i].t_name))) {
+			slot = i;
+		}
+	}
+	while (slot >= NUM_THREADS && slot < MAX_TASKS && slotUsed[slot]) {
+		slot++;
+	}
+	if (slot == MAX_TASKS) {
+		return -ENOMEM;
+	}
+	if (taskPoolAnalyse(task, TASK_POOL_ALL, policy, cpus, set, slots, &n)) {
+		return -EDEADLK;
+	}
+	taskSlots[slot] = *task;
+	slotUsed[slot] = true;
+	return slot;
+}
+
+int taskPoolRemove(int slot) {
+	if (!taskPoolGet(slot)) {
+		return -ENOENT;
+	}
+	slotUsed[slot] = false;
+	return 0;
+}
+
+/*
+ * @function taskPoolLoad
+ *
+ * @brief Replaces the pool with the n tasks in the first n slots, without
+ * 		  the admission test, so that the benchmark can run sets that miss
+ * 		  deadlines. Returns -EINVAL, and leaves the pool as it was, if a
+ * 		  task is invalid or there are more than MAX_TASKS.
+ */
+int taskPoolLoad(const struct task_s *tasks, int n) {
+	if (n < 0 || n > MAX_TASKS) {
+		return -EINVAL;
+	}
+	for (int i = 0; i < n; i++) {
+		if (!isValidTask(&tasks[i])) {
+			return -EINVAL;
+		}
+	}
+	for (int i = 0; i < MAX_TASKS; i++) {
+		slotUsed[i] = i < n;
+		if (slotUsed[i]) {
+			taskSlots[i] = tasks[i];
+		}
+	}
+	return 0;
+}
+
+void taskPoolSave(struct taskPoolSnapshot *snapshot) {
+	memcpy(snapshot->tasks, taskSlots, sizeof(taskSlots));
+	memcpy(snapshot->used, slotUsed, sizeof(slotUsed));
+}
+
+void taskPoolRestore(const struct taskPoolSnapshot *snapshot) {
+	memcpy(taskSlots, snapshot->tasks, sizeof(taskSlots));
+	memcpy(slotUsed, snapshot->used, sizeof(slotUsed));
+}
@@ -0,0 +1,39 @@
+#ifndef __TASK_POOL_H__
+#define __TASK_POOL_H__
+
+/*
+ * Runtime task set. A fixed number of slots, each backed by a preallocated
+ * thread and stack in main.c, is loaded with the task_model.h set at boot;
+ * tasks can then be added and removed from the shell between activations.
+ * A task is only added if the resulting set passes the admission test.
+ * Plain C without any Zephyr dependency, like sched_analysis.c.
+ */
+
+#include "task_model.h"
+#include "sched_analysis.h"
+
+#define MAX_TASKS 8		// slots of the thread and stack pool
+#define TASK_POOL_ALL ((1U << MAX_TASKS) - 1)	// mask of every slot
+
+/* Copy of the whole pool, so that a benchmark can put back the set it replaced */
+struct taskPoolSnapshot {
+	struct task_s tasks[MAX_TASKS];
+	bool used[MAX_TASKS];
+};
+
+void taskPoolInit(void);
+const struct task_s *taskPoolGet(int slot);
+int taskPoolNext(int slot);
+int taskPoolCount(void);
+int taskPoolFind(const char *name);
+int taskPoolModelIndex(int slot);
+uint32_t taskPoolModeSlots(int mode);
+int taskPoolAnalyse(const struct task_s *candidate, uint32_t slotMask, enum schedPolicy policy,
+					int cpus, struct schedTask *set, int *slots, int *n);
+int taskPoolAdd(const struct task_s *task, enum schedPolicy policy, int cpus);
+int taskPoolRemove(int slot);
+int taskPoolLoad(const struct task_s *tasks, int n);
+void taskPoolSave(struct taskPoolSnapshot *snapshot);
+void taskPoolRestore(const struct taskPoolSnapshot *snapshot);
+
+#endif // __TASK_POOL_H__
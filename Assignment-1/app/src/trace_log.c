@@ -0,0 +1,158 @@
+/*
+ * @file
+ * @brief Deferred, lock-free trace log of the periodic task framework.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+#include "trace_log.h"
+
+#define TRACE_DRAIN_STACKSIZE 1024
+
+struct traceRecord {
+	uint32_t cycle;
+	uint8_t event;
+	uint8_t task;
+	uint16_t reserved;
+	uint32_t arg;
+};
+
+/*
+ * One single producer / single consumer ring per producer: every task
+ * thread and the dispatcher ISR write only their own ring and the drain
+ * thread is the only consumer.
+ */
+struct traceRing {
+	struct traceRecord rec[TRACE_RING_SIZE];
+	atomic_t head;
+	atomic_t tail;
+	atomic_t dropped;
+};
+
+static struct traceRing traceRings[MAX_TASKS + 1];
+static const struct shell *traceShell;
+static uint32_t traceEpoch;
+static bool traceMuted;		// events are drained without printing them
+static K_SEM_DEFINE(drainRequest, 0, 1);
+static K_SEM_DEFINE(drainDone, 0, 1);
+
+static const char *const eventNames[] = {
+	[TRACE_JOB_START] = "job started",
+	[TRACE_JOB_DONE] = "job completed",
+	[TRACE_JOB_ABORT] = "job aborted",
+	[TRACE_DEADLINE_MISS] = "deadline missed",
+	[TRACE_RELEASE_SKIP] = "release skipped",
+	[TRACE_TASK_RETIRE] = "retired",
+	[TRACE_TASK_ADMIT] = "admitted",
+	[TRACE_CRIT_HI] = "over LO budget, switched to HI criticality",
+	[TRACE_CRIT_LO] = "system idle, back to LO criticality",
+};
+
+/*
+ * @function traceLogStart
+ *
+ * @brief Empties the rings and sets where the events of the next run go.
+ * 		  Event times are printed relative to this call.
+ */
+void traceLogStart(const struct shell *shell) {
+	traceLogSync();
+	for (int i = 0; i <= MAX_TASKS; i++) {
+		atomic_set(&traceRings[i].head, 0);
+		atomic_set(&traceRings[i].tail, 0);
+		atomic_set(&traceRings[i].dropped, 0);
+	}
+	traceShell = shell;
+	traceEpoch = k_cycle_get_32();
+}
+
+/* Hot path: a copy into the producer's ring, no locks and no I/O */
+void traceLog(int producer, enum traceEvent event, int task, uint32_t arg) {
+	struct traceRing *ring = &traceRings[producer];
+	atomic_val_t head = atomic_get(&ring->head);
+	struct traceRecord *rec;
+
+	if (head - atomic_get(&ring->tail) >= TRACE_RING_SIZE) {
+		atomic_inc(&ring->dropped);
+		return;
+	}
+	rec = &ring->rec[head & (TRACE_RING_SIZE - 1)];
+	rec->cycle = k_cycle_get_32();
+	rec->event = event;
+	rec->task = task;
+	rec->arg = arg;
+	atomic_set(&ring->head, head + 1);
+}
+
+static void tracePrint(const struct traceRecord *rec) {
+	uint32_t us = k_cyc_to_us_floor32(rec->cycle - traceEpoch);
+	const struct task_s *task = taskPoolGet(rec->task);
+	const char *name = task ? task->t_name : "removed task";
+
+	if (rec->event == TRACE_MODE_CHANGE) {
+		if (traceShell) {
+			shell_info(traceShell, "[%8u us] mode changed to %s", us, modes[rec->arg].m_name);
+		} else {
+			printk("[%8u us] mode changed to %s\n", us, modes[rec->arg].m_name);
+		}
+		return;
+	}
+	if (traceShell) {
+		shell_info(traceShell, "[%8u us] %s: %s, job %u", us, name,
+				   eventNames[rec->event], rec->arg);
+	} else {
+		printk("[%8u us] %s: %s, job %u\n", us, name,
+			   eventNames[rec->event], rec->arg);
+	}
+}
+
+static void traceDrain(void) {
+	for (int i = 0; i <= MAX_TASKS; i++) {
+		struct traceRing *ring = &traceRings[i];
+		atomic_val_t tail = atomic_get(&ring->tail);
+		atomic_val_t head = atomic_get(&ring->head);
+		atomic_val_t dropped = atomic_clear(&ring->dropped);
+
+		while (tail != head) {
+			if (!traceMuted) {
+				tracePrint(&ring->rec[tail & (TRACE_RING_SIZE - 1)]);
+			}
+			/* Freeing the slot as soon as it is printed */
+			atomic_set(&ring->tail, ++tail);
+		}
+		if (dropped) {
+			printk("trace: %d events dropped\n", (int)dropped);
+		}
+	}
+}
+
+/*
+ * @function traceLogSync
+ *
+ * @brief Waits until the drain thread has emptied every ring.
+ */
+void traceLogSync(void) {
+	k_sem_give(&drainRequest);
+	k_sem_take(&drainDone, K_FOREVER);
+}
+
+/* Drops the events instead of printing them, for runs that only report a summary */
+void traceLogMute(bool mute) {
+	traceMuted = mute;
+}
+
+static void traceDrainThread(void *p1, void *p2, void *p3) {
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+	while (1) {
+		bool requested = !k_sem_take(&drainRequest, K_MSEC(TRACE_DRAIN_PERIOD));
+
+		traceDrain();
+		if (requested) {
+			k_sem_give(&drainDone);
+		}
+	}
+}
+K_THREAD_DEFINE(traceDrainTid, TRACE_DRAIN_STACKSIZE, traceDrainThread, NULL, NULL, NULL,
+				K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
@@ -0,0 +1,37 @@
+#ifndef __TRACE_LOG_H__
+#define __TRACE_LOG_H__
+
+/*
+ * Deferred trace log. The hot paths (task threads and the release
+ * dispatcher ISR) only store a small binary event into their own lock-free
+ * ring; a thread at the lowest application priority formats the events and
+ * prints them to the shell, or with printk when no shell is attached.
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+#include "task_pool.h"
+
+#define TRACE_RING_SIZE 64		// events per producer, must be a power of two
+#define TRACE_DRAIN_PERIOD 20	// milliseconds between two drains
+#define TRACE_DISPATCHER MAX_TASKS	// producer id of the release dispatcher
+
+enum traceEvent {
+	TRACE_JOB_START,
+	TRACE_JOB_DONE,
+	TRACE_JOB_ABORT,
+	TRACE_DEADLINE_MISS,
+	TRACE_RELEASE_SKIP,
+	TRACE_TASK_RETIRE,		// arg: last job the retired task runs
+	TRACE_TASK_ADMIT,		// arg: first job released in the new mode
+	TRACE_MODE_CHANGE,		// arg: index of the new mode in modes[]
+	TRACE_CRIT_HI,			// arg: job of the task that exceeded its LO budget
+	TRACE_CRIT_LO,			// arg: job whose end left the system idle
+};
+
+void traceLogStart(const struct shell *shell);
+void traceLog(int producer, enum traceEvent event, int task, uint32_t arg);
+void traceLogSync(void);
+void traceLogMute(bool mute);
+
+#endif // __TRACE_LOG_H__
@@ -0,0 +1,142 @@
+/*
+ * @file
+ * @brief Segment execution time and blocking measurement of the task set.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <stdio.h>
+#include <string.h>
+#include "task_pool.h"
+#include "workload.h"
+#include "pcp_mutex.h"
+#include "wcet.h"
+
+/* Maxima in cycles, written only by the thread running the task */
+struct segmentTimes {
+	uint32_t alone[3];		// segments of a job running alone
+	uint32_t contended[3];	// segments including preemption
+	uint32_t blocking;		// start delay by a critical section plus wait for the lock
+	uint32_t jobs;			// jobs measured under contention
+};
+
+static struct segmentTimes times[MAX_TASKS];
+
+void wcetReset(void) {
+	memset(times, 0, sizeof(times));
+}
+
+/* Segment times of one job from its timestamps */
+static void segmentsOfJob(const struct jobRecord *job, uint32_t seg[3]) {
+	seg[0] = job->request - job->start;
+	seg[1] = job->unlocked - job->locked;
+	seg[2] = job->finish - job->unlocked;
+}
+
+/*
+ * @function wcetMeasureAlone
+ *
+ * @brief Runs the segments of a task jobs times in the calling thread,
+ * 		  raised to the run priority of the task, with no other task active.
+ * 		  The critical section uses a private ceiling mutex, which costs the
+ * 		  same as the shared one but is never contended.
+ */
+void wcetMeasureAlone(int taskNumber, int priority, int jobs) {
+	const struct task_s *taskInfo = taskPoolGet(taskNumber);
+	k_tid_t self = k_current_get();
+	int saved = k_thread_priority_get(self);
+	struct ceilingMutex lock;
+	struct jobRecord job;
+	uint32_t seg[3];
+
+	ceilingMutexInit(&lock, priority);
+	k_thread_priority_set(self, priority);
+	for (int j = 0; j < jobs; j++) {
+		job.start = k_cycle_get_32();
+		computeSegment(taskNumber, 0, taskInfo->exec_us[0]);
+		job.request = k_cycle_get_32();
+		ceilingMutexLock(&lock);
+		job.locked = k_cycle_get_32();
+		computeSegment(taskNumber, 1, taskInfo->exec_us[1]);
+		ceilingMutexUnlock(&lock);
+		job.unlocked = k_cycle_get_32();
+		computeSegment(taskNumber, 2, taskInfo->exec_us[2]);
+		job.finish = k_cycle_get_32();
+		segmentsOfJob(&job, seg);
+		for (int k = 0; k < 3; k++) {
+			times[taskNumber].alone[k] = MAX(times[taskNumber].alone[k], seg[k]);
+		}
+	}
+	k_thread_priority_set(self, saved);
+}
+
+/*
+ * @function wcetRecord
+ *
+ * @brief Called by a task thread for every completed job of a contended
+ * 		  run. The blocking of the job is the delay of its start by a lower
+ * 		  priority critical section plus its own wait for the lock.
+ */
+void wcetRecord(int taskNumber, const struct jobRecord *job) {
+	struct segmentTimes *t = &times[taskNumber];
+	uint32_t seg[3];
+
+	segmentsOfJob(job, seg);
+	for (int k = 0; k < 3; k++) {
+		t->contended[k] = MAX(t->contended[k], seg[k]);
+	}
+	t->blocking = MAX(t->blocking, job->blocked + (job->locked - job->request));
+	t->jobs++;
+}
+
+/*
+ * @function wcetPrintTable
+ *
+ * @brief Prints the measurements as the contents of src/wcet_table.h, times
+ * 		  rounded up to whole microseconds. The segment times of the run
+ * 		  alone become the execution times of the task model; the contended
+ * 		  segment times, which include preemption, are only comments. Model
+ * 		  tasks removed from the pool keep their current values, and tasks
+ * 		  added at runtime have no entry in the table and are printed as
+ * 		  comments.
+ */
+void wcetPrintTable(const struct shell *shell, int jobs) {
+	char blocking[16 * NUM_THREADS];
+	int len = 0;
+
+	shell_print(shell, "/* Measured by the \"wcet\" shell command: %d jobs per task alone, "
+				"%d ms under contention */", jobs, TOTAL_TIME);
+	for (int i = 0; i < NUM_THREADS; i++) {
+		const struct segmentTimes *t = &times[i];
+
+		if (taskPoolModelIndex(i) < 0) {
+			shell_print(shell, "#define TASK%d_EXEC_US {%d, %d, %d}\t/* %s, not measured */",
+						i, threads[i].exec_us[0], threads[i].exec_us[1], threads[i].exec_us[2],
+						threads[i].t_name);
+			len += snprintf(&blocking[len], sizeof(blocking) - len, "%s0", i ? ", " : "");
+			continue;
+		}
+		shell_print(shell, "#define TASK%d_EXEC_US {%u, %u, %u}\t/* %s, %u jobs contended: %u/%u/%u us */",
+					i, k_cyc_to_us_ceil32(t->alone[0]), k_cyc_to_us_ceil32(t->alone[1]),
+					k_cyc_to_us_ceil32(t->alone[2]), threads[i].t_name, t->jobs,
+					k_cyc_to_us_ceil32(t->contended[0]), k_cyc_to_us_ceil32(t->contended[1]),
+					k_cyc_to_us_ceil32(t->contended[2]));
+		len += snprintf(&blocking[len], sizeof(blocking) - len, "%s%u",
+						i ? ", " : "", k_cyc_to_us_ceil32(t->blocking));
+	}
+	shell_print(shell, "#define MEASURED_BLOCKING_US {%s}", blocking);
+	for (int i = taskPoolNext(0); i < MAX_TASKS; i = taskPoolNext(i + 1)) {
+		const struct segmentTimes *t = &times[i];
+
+		if (taskPoolModelIndex(i) >= 0) {
+			continue;
+		}
+		shell_print(shell, "/* %s, added at runtime: {%u, %u, %u}, %u jobs contended: "
+					"%u/%u/%u us, blocking %u us */", taskPoolGet(i)->t_name,
+					k_cyc_to_us_ceil32(t->alone[0]), k_cyc_to_us_ceil32(t->alone[1]),
+					k_cyc_to_us_ceil32(t->alone[2]), t->jobs,
+					k_cyc_to_us_ceil32(t->contended[0]), k_cyc_to_us_ceil32(t->contended[1]),
+					k_cyc_to_us_ceil32(t->contended[2]), k_cyc_to_us_ceil32(t->blocking));
+	}
+}
@@ -0,0 +1,22 @@
+#ifndef __WCET_H__
+#define __WCET_H__
+
+/*
+ * Execution time measurement of the task segments. Every task is first run
+ * alone, job after job at its own priority, which gives the execution time
+ * of each segment; the whole set is then run under contention, which gives
+ * the blocking of each task. The result is printed as a wcet_table.h.
+ */
+
+#include <zephyr.h>
+#include <shell/shell.h>
+#include "job_stats.h"
+
+#define WCET_JOBS 100	// jobs per task in the run alone
+
+void wcetReset(void);
+void wcetMeasureAlone(int taskNumber, int priority, int jobs);
+void wcetRecord(int taskNumber, const struct jobRecord *job);
+void wcetPrintTable(const struct shell *shell, int jobs);
+
+#endif // __WCET_H__
@@ -0,0 +1,247 @@
+/*
+ * @file
+ * @brief Calibrated compute workload of the periodic tasks.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <zephyr.h>
+#include <timing/timing.h>
+#include <string.h>
+#include "task_pool.h"
+#include "workload.h"
+
+#define CALIBRATION_ITER 100000	// iterations timed per calibration run
+#define CALIBRATION_RUNS 5			// the fastest run is kept
+
+static uint32_t iterPerMs;
+
+/*
+ * @function compute: compute function to keep the CPU busy.
+ */
+void compute(uint32_t numiterations) {
+	volatile uint64_t x = numiterations;
+	while(x > 0)
+		x--;
+}
+
+/*
+ * @function computeUs: keeps the CPU busy for the given number of
+ * 						microseconds of execution time.
+ */
+void computeUs(uint32_t us) {
+	compute((uint32_t)((uint64_t)us * iterPerMs / USEC_PER_MSEC));
+}
+
+/*
+ * @function workloadCalibrate
+ *
+ * @brief Times compute() with the timing API and stores the number of
+ * 		  iterations per millisecond. Each run executes with interrupts
+ * 		  locked so that it is not stretched by preemption, and the fastest
+ * 		  run is kept. The result depends on the board, the clock and the
+ * 		  compiler flags, which is why it is measured instead of configured.
+ */
+void workloadCalibrate(void) {
+	uint64_t bestNs = UINT64_MAX;
+
+	timing_init();
+	timing_start();
+	for (int run = 0; run < CALIBRATION_RUNS; run++) {
+		unsigned int key = irq_lock();
+		timing_t start = timing_counter_get();
+		compute(CALIBRATION_ITER);
+		timing_t end = timing_counter_get();
+		irq_unlock(key);
+
+		bestNs = MIN(bestNs, timing_cycles_to_ns(timing_cycles_get(&start, &end)));
+	}
+	iterPerMs = (uint32_t)((uint64_t)CALIBRATION_ITER * NSEC_PER_USEC * USEC_PER_MSEC /
+						   MAX(bestNs, 1));
+}
+
+uint32_t workloadIterPerMs(void) {
+	return iterPerMs;
+}
+
+/*
+ * Memory kernels. Every slot works on its own window of the arena, a power
+ * of two words large so that positions wrap with a mask. Windows that do
+ * not fit any more share the start of the arena. The kernels write back
+ * what they read and mask the positions they load, so a shared window only
+ * costs extra interference.
+ */
+#define ARENA_WORDS (CONFIG_APP_WORKLOAD_ARENA_KB * 1024 / sizeof(uint32_t))
+#define LINE_WORDS (WORKLOAD_LINE / sizeof(uint32_t))
+#define KERNEL_CALIBRATION_ITER 10000	// the memory kernels are slower per iteration
+
+static uint32_t workloadArena[ARENA_WORDS] __aligned(WORKLOAD_LINE);
+static uint32_t arenaUsed;		// words handed out in this run
+
+struct workloadSlot {
+	volatile uint32_t *buf;
+	uint32_t mask;						// words of the window - 1
+	uint32_t pos[NUM_KERNELS];			// where each kernel carries on in the next segment
+	uint32_t iterPerMs[NUM_KERNELS];	// 0 for the kernels the task does not use
+	int kernel[3];
+};
+
+static struct workloadSlot workloadSlots[MAX_TASKS];
+
+static const char *const kernelNames[NUM_KERNELS] = {
+	[KERNEL_ALU] = "alu",
+	[KERNEL_STREAM] = "stream",
+	[KERNEL_CHASE] = "chase",
+	[KERNEL_THRASH] = "thrash",
+	[KERNEL_MATH] = "math",
+};
+
+const char *workloadKernelName(int kernel) {
+	return kernelNames[kernel];
+}
+
+/* Kernel with the given name, -EINVAL if there is none */
+int workloadKernelFind(const char *name) {
+	for (int k = 0; k < NUM_KERNELS; k++) {
+		if (!strcmp(name, kernelNames[k])) {
+			return k;
+		}
+	}
+	return -EINVAL;
+}
+
+/* Runs iterations of a memory kernel, an iteration is one access or one multiply-accumulate */
+static void runKernel(struct workloadSlot *s, int kernel, uint32_t iterations) {
+	volatile uint32_t *buf = s->buf;
+	uint32_t mask = s->mask;
+	uint32_t pos = s->pos[kernel];
+	volatile float acc = 0.0f;
+
+	switch (kernel) {
+	case KERNEL_STREAM:
+		while (iterations--) {
+			buf[pos] = buf[pos];
+			pos = (pos + 1) & mask;
+		}
+		break;
+	case KERNEL_CHASE:
+		while (iterations--) {
+			pos = buf[pos] & mask;
+		}
+		break;
+	case KERNEL_THRASH:
+		while (iterations--) {
+			buf[pos] = buf[pos];
+			pos = (pos + LINE_WORDS) & mask;
+		}
+		break;
+	case KERNEL_MATH:
+		while (iterations--) {
+			acc = acc * 0.999f + (float)(buf[pos] & 0xff) / 3.0f;
+			pos = (pos + 1) & mask;
+		}
+		break;
+	default:
+		compute(iterations);
+		break;
+	}
+	s->pos[kernel] = pos;
+}
+
+/*
+ * Links the cache lines of a window into one random cycle for the chase
+ * kernel (Sattolo's shuffle), so that every load depends on the previous
+ * one and the prefetcher cannot guess the next line.
+ */
+static void linkChase(struct workloadSlot *s) {
+	uint32_t lines = (s->mask + 1) / LINE_WORDS;
+	uint32_t seed = (uint32_t)(uintptr_t)s->buf | 1;
+
+	for (uint32_t i = 0; i < lines; i++) {
+		s->buf[i * LINE_WORDS] = i * LINE_WORDS;
+	}
+	for (uint32_t i = lines - 1; i > 0; i--) {
+		uint32_t j, tmp;
+
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		j = seed % i;
+		tmp = s->buf[i * LINE_WORDS];
+		s->buf[i * LINE_WORDS] = s->buf[j * LINE_WORDS];
+		s->buf[j * LINE_WORDS] = tmp;
+	}
+}
+
+/* Like workloadCalibrate(), for a memory kernel over the window of a slot */
+static uint32_t calibrateKernel(struct workloadSlot *s, int kernel) {
+	uint64_t bestNs = UINT64_MAX;
+
+	for (int run = 0; run < CALIBRATION_RUNS; run++) {
+		unsigned int key = irq_lock();
+		timing_t start = timing_counter_get();
+		runKernel(s, kernel, KERNEL_CALIBRATION_ITER);
+		timing_t end = timing_counter_get();
+		irq_unlock(key);
+
+		bestNs = MIN(bestNs, timing_cycles_to_ns(timing_cycles_get(&start, &end)));
+	}
+	return (uint32_t)((uint64_t)KERNEL_CALIBRATION_ITER * NSEC_PER_USEC * USEC_PER_MSEC /
+					  MAX(bestNs, 1));
+}
+
+/* Hands the whole arena back before the slots of a run are prepared */
+void workloadReset(void) {
+	arenaUsed = 0;
+}
+
+/*
+ * @function workloadPrepare
+ *
+ * @brief Places the working set of a slot's task in the arena, rounded down
+ * 		  to a power of two of at least one cache line, and calibrates the
+ * 		  kernels its segments use. Calibration runs warm, so the times of
+ * 		  a segment only grow when other tasks evict its working set, which
+ * 		  is the interference the memory kernels are there to show. Returns
+ * 		  -ENOMEM when the window had to share memory with another slot.
+ */
+int workloadPrepare(int slot, const struct task_s *task) {
+	struct workloadSlot *s = &workloadSlots[slot];
+	uint32_t words = LINE_WORDS;
+	int ret = 0;
+
+	while (words * 2 <= MIN(task->working_set / sizeof(uint32_t), ARENA_WORDS)) {
+		words *= 2;
+	}
+	if (arenaUsed + words > ARENA_WORDS) {
+		arenaUsed = 0;
+		ret = -ENOMEM;
+	}
+	s->buf = &workloadArena[arenaUsed];
+	s->mask = words - 1;
+	memset(s->pos, 0, sizeof(s->pos));
+	arenaUsed += words;
+	memset(s->iterPerMs, 0, sizeof(s->iterPerMs));
+	memcpy(s->kernel, task->kernel, sizeof(s->kernel));
+	for (int k = 0; k < 3; k++) {
+		if (task->kernel[k] == KERNEL_CHASE && !s->iterPerMs[KERNEL_CHASE]) {
+			linkChase(s);
+		}
+		if (task->kernel[k] == KERNEL_ALU) {
+			s->iterPerMs[KERNEL_ALU] = iterPerMs;
+		} else if (!s->iterPerMs[task->kernel[k]]) {
+			s->iterPerMs[task->kernel[k]] = calibrateKernel(s, task->kernel[k]);
+		}
+	}
+	return ret;
+}
+
+/*
+ * @function computeSegment: keeps the CPU busy for us microseconds of
+ * 							 execution time with the kernel of a segment.
+ */
+void computeSegment(int slot, int segment, uint32_t us) {
+	struct workloadSlot *s = &workloadSlots[slot];
+	int kernel = s->kernel[segment];
+
+	runKernel(s, kernel, (uint32_t)((uint64_t)us * s->iterPerMs[kernel] / USEC_PER_MSEC));
+}
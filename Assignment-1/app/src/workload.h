@@ -0,0 +1,28 @@
+#ifndef __WORKLOAD_H__
+#define __WORKLOAD_H__
+
+/*
+ * CPU workload of the compute segments. compute() burns a number of loop
+ * iterations; computeUs() burns a time, using the iterations per millisecond
+ * measured by workloadCalibrate() at boot. computeSegment() runs a segment
+ * on the kernel task_s.kernel selects for it, over the task's working set
+ * in a static arena; workloadPrepare() places and calibrates the kernels of
+ * a slot before a run.
+ */
+
+#include <zephyr.h>
+#include "task_model.h"
+
+#define WORKLOAD_LINE 32	// bytes per cache line, the stride of the chase and thrash kernels
+
+void compute(uint32_t numiterations);
+void computeUs(uint32_t us);
+void workloadCalibrate(void);
+uint32_t workloadIterPerMs(void);
+void workloadReset(void);
+int workloadPrepare(int slot, const struct task_s *task);
+void computeSegment(int slot, int segment, uint32_t us);
+const char *workloadKernelName(int kernel);
+int workloadKernelFind(const char *name);
+
+#endif // __WORKLOAD_H__
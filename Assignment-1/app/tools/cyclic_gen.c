@@ -0,0 +1,222 @@
+/*
+ * @file
+ * @brief Host side generator of the cyclic executive frame table. Builds a
+ * 		  static schedule of src/task_model.h over its hyperperiod and writes
+ * 		  it as a C source file, run as part of the build.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "task_model.h"
+
+#define MAX_JOBS 16384		// jobs in one hyperperiod
+#define MAX_ENTRIES 65535	// entries addressable by the uint16_t frame index
+
+struct job {
+	int task;
+	uint32_t release;	// in microseconds from the start of the hyperperiod
+	uint32_t deadline;
+	int segment;		// next segment to run, 3 when complete
+};
+
+struct entry {
+	uint8_t task;
+	uint8_t segment;
+};
+
+static struct job jobs[MAX_JOBS];
+static struct entry entries[MAX_ENTRIES];
+static uint32_t frameStart[MAX_ENTRIES + 1];
+static int jobCount, entryCount;
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+	while (b) {
+		uint64_t r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+/* Releases every job of the hyperperiod, in order of release */
+static int releaseJobs(uint64_t hyperperiod) {
+	jobCount = 0;
+	for (int i = 0; i < NUM_THREADS; i++) {
+		for (uint64_t r = 0; r < hyperperiod; r += threads[i].period) {
+			if (jobCount == MAX_JOBS) {
+				return -1;
+			}
+			jobs[jobCount].task = i;
+			jobs[jobCount].release = (uint32_t)(r * 1000);
+			jobs[jobCount].deadline = (uint32_t)((r + threads[i].period) * 1000);
+			jobs[jobCount].segment = 0;
+			jobCount++;
+		}
+	}
+	return 0;
+}
+
+/*
+ * @function buildTable
+ *
+ * @brief Fills the frames of length frame ms with job segments. At the start
+ * 		  of every frame the released, unfinished job with the earliest
+ * 		  deadline (then the most urgent priority) whose next segment still
+ * 		  fits in the frame runs that segment, until no segment fits. A
+ * 		  segment is never split, so the critical section of a job is never
+ * 		  interleaved with another job. Fails when a job is unfinished at
+ * 		  the end of the frame containing its deadline.
+ */
+static int buildTable(uint64_t hyperperiod, uint32_t frame, uint32_t slack) {
+	uint32_t frames = (uint32_t)(hyperperiod / frame);
+	uint32_t capacity = frame * 1000 - slack;
+
+	if (releaseJobs(hyperperiod)) {
+		return -1;
+	}
+	entryCount = 0;
+	for (uint32_t j = 0; j < frames; j++) {
+		uint32_t start = j * frame * 1000;
+		uint32_t end = start + frame * 1000;
+		uint32_t used = 0;
+
+		frameStart[j] = entryCount;
+		for (;;) {
+			int best = -1;
+			for (int k = 0; k < jobCount; k++) {
+				const struct job *job = &jobs[k];
+				if (job->release > start || job->segment == 3 ||
+					used + threads[job->task].exec_us[job->segment] > capacity) {
+					continue;
+				}
+				if (best < 0 || job->deadline < jobs[best].deadline ||
+					(job->deadline == jobs[best].deadline &&
+					 threads[job->task].priority < threads[jobs[best].task].priority)) {
+					best = k;
+				}
+			}
+			if (best < 0) {
+				break;
+			}
+			if (entryCount == MAX_ENTRIES) {
+				return -1;
+			}
+			entries[entryCount].task = jobs[best].task;
+			entries[entryCount].segment = jobs[best].segment;
+			entryCount++;
+			used += threads[jobs[best].task].exec_us[jobs[best].segment];
+			jobs[best].segment++;
+		}
+		for (int k = 0; k < jobCount; k++) {
+			if (jobs[k].segment < 3 && jobs[k].deadline <= end) {
+				return -1;
+			}
+		}
+	}
+	frameStart[frames] = entryCount;
+	return 0;
+}
+
+/*
+ * A frame of f ms must divide the hyperperiod, hold the longest segment and
+ * satisfy 2f - gcd(f, T_i) <= D_i for every task, so that a frame lies
+ * entirely between the release and the deadline of every job.
+ */
+static int isValidFrame(uint64_t hyperperiod, uint32_t frame, uint32_t slack) {
+	if (hyperperiod % frame || frame * 1000 <= slack) {
+		return 0;
+	}
+	for (int i = 0; i < NUM_THREADS; i++) {
+		for (int s = 0; s < 3; s++) {
+			if ((uint32_t)threads[i].exec_us[s] > frame * 1000 - slack) {
+				return 0;
+			}
+		}
+		if (2 * (uint64_t)frame - gcd(frame, threads[i].period) > (uint64_t)threads[i].period) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void writeTable(FILE *out, uint64_t hyperperiod, uint32_t frame) {
+	uint32_t frames = (uint32_t)(hyperperiod / frame);
+
+	fprintf(out, "/* Generated by tools/cyclic_gen.c from task_model.h, do not edit. */\n\n");
+	fprintf(out, "#include \"cyclic_table.h\"\n\n");
+	fprintf(out, "/* Hyperperiod %llu ms */\n", (unsigned long long)hyperperiod);
+	fprintf(out, "const uint32_t cyclicFrameUs = %u;\n", frame * 1000);
+	fprintf(out, "const uint32_t cyclicFrameCount = %u;\n\n", frames);
+	fprintf(out, "const uint16_t cyclicFrameStart[] = {");
+	for (uint32_t j = 0; j <= frames; j++) {
+		fprintf(out, "%s%u,", j % 16 ? " " : "\n\t", frameStart[j]);
+	}
+	fprintf(out, "\n};\n\nconst struct cyclicEntry cyclicEntries[] = {");
+	for (int e = 0; e < entryCount; e++) {
+		fprintf(out, "%s{%u, %u},", e % 8 ? " " : "\n\t", entries[e].task, entries[e].segment);
+	}
+	fprintf(out, "\n};\n");
+}
+
+int main(int argc, char **argv) {
+	const char *output = NULL;
+	uint64_t hyperperiod = 1;
+	uint32_t slack = 500;
+	uint32_t frame = 0;
+	FILE *out;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--slack") && i + 1 < argc) {
+			slack = (uint32_t)atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--frame") && i + 1 < argc) {
+			frame = (uint32_t)atoi(argv[++i]);
+		} else if (!output && argv[i][0] != '-') {
+			output = argv[i];
+		} else {
+			output = NULL;
+			break;
+		}
+	}
+	if (!output) {
+		fprintf(stderr, "usage: %s [--slack us] [--frame ms] output.c\n", argv[0]);
+		return 2;
+	}
+	for (int i = 0; i < NUM_THREADS; i++) {
+		hyperperiod = hyperperiod / gcd(hyperperiod, threads[i].period) * threads[i].period;
+	}
+	if (frame) {
+		if (!isValidFrame(hyperperiod, frame, slack) || buildTable(hyperperiod, frame, slack)) {
+			fprintf(stderr, "error: no cyclic schedule with %u ms frames\n", frame);
+			return 1;
+		}
+	} else {
+		/* The largest valid frame that yields a schedule, for the fewest timer expiries */
+		uint32_t largest = 0;
+		for (int i = 0; i < NUM_THREADS; i++) {
+			largest = largest > (uint32_t)threads[i].period ? largest : (uint32_t)threads[i].period;
+		}
+		for (frame = largest; frame > 0; frame--) {
+			if (isValidFrame(hyperperiod, frame, slack) && !buildTable(hyperperiod, frame, slack)) {
+				break;
+			}
+		}
+		if (!frame) {
+			fprintf(stderr, "error: task_model.h has no cyclic schedule\n");
+			return 1;
+		}
+	}
+	out = fopen(output, "w");
+	if (!out) {
+		perror(output);
+		return 1;
+	}
+	writeTable(out, hyperperiod, frame);
+	fclose(out);
+	printf("-- Cyclic executive: %u ms frames, %llu frames per %llu ms hyperperiod, %d segments\n",
+		   frame, (unsigned long long)(hyperperiod / frame), (unsigned long long)hyperperiod,
+		   entryCount);
+	return 0;
+}
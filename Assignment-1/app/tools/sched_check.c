@@ -0,0 +1,137 @@
+/*
+ * @file
+ * @brief Host side schedulability check of src/task_model.h, run as part of
+ * 		  the build. Prints a response time report and, with --strict, exits
+ * 		  with an error when a task can miss its deadline.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "task_model.h"
+#include "sched_analysis.h"
+
+int main(int argc, char **argv) {
+	struct schedTask set[NUM_THREADS];
+	const uint32_t measured[NUM_THREADS] = MEASURED_BLOCKING_US;
+	enum lockProtocol protocol = LOCK_INHERITANCE;
+	enum schedPolicy policy = POLICY_RM;
+	int strict = 0;
+	int cpus = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--strict")) {
+			strict = 1;
+		} else if (!strcmp(argv[i], "--ceiling")) {
+			protocol = LOCK_CEILING;
+		} else if (!strcmp(argv[i], "--edf")) {
+			policy = POLICY_EDF;
+		} else if (!strcmp(argv[i], "--cpus") && i + 1 < argc) {
+			cpus = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--strict] [--ceiling] [--edf] [--cpus n]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	for (int i = 0; i < NUM_THREADS; i++) {
+		schedTaskFromModel(&threads[i], &set[i]);
+	}
+	int misfits = cpus > 1 ? schedPartition(set, NUM_THREADS, cpus, policy) : 0;
+	int misses = policy == POLICY_EDF ? schedEdfTest(set, NUM_THREADS) :
+				 schedHasThresholds(set, NUM_THREADS) ?
+				 schedThresholdResponseTime(set, NUM_THREADS, protocol) :
+				 schedResponseTimeAnalysis(set, NUM_THREADS, protocol);
+	uint32_t util = schedUtilization(set, NUM_THREADS);
+
+	printf("-- Task set schedulability (%s, %s, %d tasks, %d cpus, U = %u.%04u)\n",
+		   policy == POLICY_EDF ? "EDF" : "RM",
+		   protocol == LOCK_CEILING ? "priority ceiling" : "priority inheritance",
+		   NUM_THREADS, cpus, util / UTIL_ONE, (util % UTIL_ONE) / 100);
+	if (misfits) {
+		printf("--   %d task(s) fit on no core by utilisation\n", misfits);
+	}
+	printf("--   %-8s %3s %4s %4s %8s %8s %8s %8s %8s %8s\n", "task", "cpu", "prio", "thr",
+		   "T(us)", "C(us)", "B(us)", "Bm(us)", "R(us)", "D(us)");
+	for (int i = 0; i < NUM_THREADS; i++) {
+		printf("--   %-8s %3d %4d %4d %8u %8u %8u %8u %8u %8u %s\n", set[i].name, set[i].cpu,
+			   set[i].priority, policy == POLICY_EDF ? set[i].priority : set[i].threshold,
+			   set[i].period, set[i].wcet,
+			   set[i].blocking, measured[i], set[i].response, set[i].deadline,
+			   set[i].schedulable ? "ok" : "MISS");
+		/* Measured blocking beyond the bound means the model misses a lock */
+		if (measured[i] > set[i].blocking) {
+			printf("--   %-8s measured blocking exceeds the analysed bound\n", set[i].name);
+		}
+	}
+	/* The largest thresholds the set allows, next to the ones of task_model.h */
+	if (policy == POLICY_RM) {
+		struct schedTask search[NUM_THREADS];
+
+		memcpy(search, set, sizeof(search));
+		if (!schedAssignThresholds(search, NUM_THREADS, protocol)) {
+			printf("-- Preemption thresholds (largest that keep the set schedulable)\n");
+			for (int i = 0; i < NUM_THREADS; i++) {
+				printf("--   %-8s priority %d, threshold %d%s\n", search[i].name,
+					   search[i].priority, search[i].threshold,
+					   search[i].threshold == set[i].threshold ? "" : ", differs from task_model.h");
+			}
+		}
+	}
+	/*
+	 * Bound on the data age of each chain: every task may read the newest
+	 * output of its predecessor up to a period plus a response time late,
+	 * so the bound is the sum of T + R along the chain (R = D under EDF).
+	 */
+	for (int c = 0; c < NUM_CHAINS; c++) {
+		uint32_t bound = 0;
+
+		if (chains[c].length < 2 || chains[c].length > MAX_CHAIN_TASKS) {
+			fprintf(stderr, "error: chain %s needs 2 to %d tasks\n", chains[c].c_name, MAX_CHAIN_TASKS);
+			return 2;
+		}
+		printf("-- Chain %s:", chains[c].c_name);
+		for (int p = 0; p < chains[c].length; p++) {
+			int t = chains[c].tasks[p];
+
+			if (t < 0 || t >= NUM_THREADS) {
+				fprintf(stderr, "\nerror: chain %s names task %d\n", chains[c].c_name, t);
+				return 2;
+			}
+			bound += set[t].period + (policy == POLICY_EDF ? set[t].deadline : set[t].response);
+			printf(" %s%s", p ? "-> " : "", set[t].name);
+		}
+		printf(", data age bound %u us\n", bound);
+	}
+	/* The LO/HI budgets of a mixed criticality set are checked with AMC-rtb */
+	if (policy == POLICY_RM && schedHasHiTasks(set, NUM_THREADS)) {
+		int amcMisses = schedAmcResponseTime(set, NUM_THREADS, protocol);
+
+		printf("-- Mixed criticality (AMC-rtb)\n");
+		printf("--   %-8s %4s %8s %8s %8s %8s %8s\n",
+			   "task", "crit", "C(LO)", "C(HI)", "R(LO)", "R(HI)", "D(us)");
+		for (int i = 0; i < NUM_THREADS; i++) {
+			if (set[i].criticality == CRIT_HI) {
+				printf("--   %-8s %4s %8u %8u %8u %8u %8u %s\n", set[i].name, "HI",
+					   set[i].budget[CRIT_LO], set[i].budget[CRIT_HI], set[i].response,
+					   set[i].responseHi, set[i].deadline, set[i].schedulable ? "ok" : "MISS");
+			} else {
+				printf("--   %-8s %4s %8u %8s %8u %8s %8u %s\n", set[i].name, "LO",
+					   set[i].budget[CRIT_LO], "-", set[i].response, "-", set[i].deadline,
+					   set[i].schedulable ? "ok" : "MISS");
+			}
+			/* A LO budget below the declared execution time switches to HI every job */
+			if (set[i].budget[CRIT_LO] < set[i].wcet) {
+				printf("--   %-8s LO budget is below its execution time\n", set[i].name);
+			}
+		}
+		misses += amcMisses;
+	}
+	if (misses) {
+		fprintf(stderr, "%s: %d task(s) in task_model.h can miss their deadline\n",
+				strict ? "error" : "warning", misses);
+		return strict ? 1 : 0;
+	}
+	return 0;
+}
@@ -0,0 +1,664 @@
+/*
+ * @file
+ * @brief Host side discrete event simulator of the task_model.h and
+ * 		  task_model_p4.h task sets. Prints the simulated response times,
+ * 		  deadline misses and aperiodic server figures, and optionally a
+ * 		  Gantt trace to check on-target traces against.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+#define SIM_IDLE -1
+#define CHART_COLUMNS 100
+
+/* A released job waiting behind the one a task runs */
+struct jobState {
+	uint32_t release;
+	uint32_t seq;
+};
+
+struct taskState {
+	uint32_t nextRelease;
+	uint32_t seq;					// sequence number of the last release
+	struct jobState queue[SIM_MAX_QUEUE];
+	int queued;
+	bool active;					// a job is in progress
+	struct jobState job;
+	int segment;
+	uint32_t left;					// execution left in the segment
+	bool started;
+	bool holds;						// holds the mutex of the segment
+	bool blocked;					// waits for the mutex of the segment
+	uint32_t readySince;
+};
+
+struct request {
+	uint32_t id;
+	uint32_t arrival;
+	uint32_t left;
+};
+
+struct serverState {
+	uint32_t nextReplenish;
+	uint32_t nextArrival;
+	uint32_t budget;
+	bool active;					// polls at its next turn on the CPU
+	struct request queue[SIM_MAX_QUEUE];
+	int head;
+	int count;
+	bool busy;						// a request is in service
+	struct request current;
+	uint32_t ids;
+	uint32_t readySince;
+	/* Sporadic server: the running activation and the pending replenishments */
+	bool activation;
+	uint32_t activationStart;
+	uint32_t activationUsed;
+	uint32_t replenishAt[SIM_MAX_REPLENISH];
+	uint32_t replenishUs[SIM_MAX_REPLENISH];
+	int replenishCount;
+};
+
+static const char *const serverKinds[] = {"polling", "deferrable", "sporadic"};
+
+struct simState {
+	const struct simModel *model;
+	const struct simOptions *options;
+	struct simResult *result;
+	struct taskState tasks[SIM_MAX_TASKS];
+	struct serverState server;
+	int owner[SIM_MAX_MUTEXES];		// task holding each mutex, -1 when free
+	int ceiling[SIM_MAX_MUTEXES];
+};
+
+static int segmentMutex(const struct simState *s, int i) {
+	return s->model->tasks[i].segments[s->tasks[i].segment].mutex;
+}
+
+/* Priority a task runs at: threshold once started, raised by the mutex it holds */
+static int taskPriority(const struct simState *s, int i) {
+	const struct simTask *task = &s->model->tasks[i];
+	const struct taskState *t = &s->tasks[i];
+	int priority = t->started && s->options->thresholds ? task->threshold : task->priority;
+
+	if (t->holds) {
+		int m = segmentMutex(s, i);
+
+		if (!s->options->inherit) {
+			priority = priority < s->ceiling[m] ? priority : s->ceiling[m];
+		} else {
+			for (int k = 0; k < s->model->numTasks; k++) {
+				if (s->tasks[k].blocked && segmentMutex(s, k) == m &&
+					s->model->tasks[k].priority < priority) {
+					priority = s->model->tasks[k].priority;
+				}
+			}
+		}
+	}
+	return priority;
+}
+
+static void startJob(struct simState *s, int i, struct jobState job, uint32_t now) {
+	struct taskState *t = &s->tasks[i];
+
+	t->active = true;
+	t->job = job;
+	t->segment = 0;
+	t->left = s->model->tasks[i].segments[0].execUs;
+	t->started = false;
+	t->holds = false;
+	t->blocked = false;
+	t->readySince = now;
+}
+
+static void release(struct simState *s, int i, uint32_t now) {
+	const struct simTask *task = &s->model->tasks[i];
+	struct taskState *t = &s->tasks[i];
+	struct jobState job = {now, ++t->seq};
+
+	t->nextRelease += task->periodUs;
+	if (!t->active) {
+		startJob(s, i, job, now);
+	} else if (task->overrun != SIM_OVERRUN_SKIP && t->queued < task->queueDepth) {
+		t->queue[t->queued++] = job;
+	} else {
+		s->result->tasks[i].skipped++;
+	}
+}
+
+/* Ends the job of a task, completed or aborted, and starts the next queued one */
+static void endJob(struct simState *s, int i, uint32_t now, bool aborted) {
+	const struct simTask *task = &s->model->tasks[i];
+	struct taskState *t = &s->tasks[i];
+	struct simTaskResult *r = &s->result->tasks[i];
+	uint32_t response = now - t->job.release;
+
+	if (aborted) {
+		r->aborted++;
+		r->misses++;
+	} else {
+		r->jobs++;
+		r->responseSum += response;
+		r->responseMax = response > r->responseMax ? response : r->responseMax;
+		r->misses += response > task->periodUs;
+	}
+	t->active = false;
+	if (t->queued) {
+		struct jobState next = t->queue[0];
+
+		memmove(&t->queue[0], &t->queue[1], --t->queued * sizeof(t->queue[0]));
+		startJob(s, i, next, now);
+	}
+}
+
+/* Hands a released mutex to its most urgent waiter, like a k_mutex */
+static void unlock(struct simState *s, int m) {
+	int next = -1;
+
+	s->owner[m] = -1;
+	for (int k = 0; k < s->model->numTasks; k++) {
+		if (s->tasks[k].blocked && segmentMutex(s, k) == m &&
+			(next < 0 || s->model->tasks[k].priority < s->model->tasks[next].priority)) {
+			next = k;
+		}
+	}
+	if (next >= 0) {
+		s->owner[m] = next;
+		s->tasks[next].blocked = false;
+		s->tasks[next].holds = true;
+	}
+}
+
+/* A segment of a task ran to its end */
+static void segmentDone(struct simState *s, int i, uint32_t now) {
+	const struct simTask *task = &s->model->tasks[i];
+	struct taskState *t = &s->tasks[i];
+
+	if (t->holds) {
+		t->holds = false;
+		unlock(s, segmentMutex(s, i));
+	}
+	if (++t->segment == task->numSegments) {
+		endJob(s, i, now, false);
+		return;
+	}
+	/* A late job is abandoned at a segment boundary */
+	if (task->overrun == SIM_OVERRUN_ABORT && now > t->job.release + task->periodUs) {
+		endJob(s, i, now, true);
+		return;
+	}
+	t->left = task->segments[t->segment].execUs;
+}
+
+static void arrival(struct simState *s, uint32_t now) {
+	const struct simServer *server = &s->model->server;
+	struct serverState *v = &s->server;
+
+	s->result->server.arrivals++;
+	if (v->count < server->queueDepth) {
+		struct request *req = &v->queue[(v->head + v->count++) % SIM_MAX_QUEUE];
+
+		if (!v->busy && v->count == 1) {
+			v->readySince = now;
+		}
+		req->id = v->ids++;
+		req->arrival = now;
+		req->left = server->randDist(server->execUs, server->execVar);
+	} else {
+		s->result->server.dropped++;
+	}
+	v->nextArrival += server->randDist(server->arrivalUs, server->arrivalVar);
+}
+
+/*
+ * The polling and the deferrable server get a full budget every period, the
+ * polling server polls the queue once with it
+ */
+static void replenish(struct simState *s, uint32_t now) {
+	struct serverState *v = &s->server;
+
+	if (!v->active) {
+		v->readySince = now;
+	}
+	v->budget = s->model->server.budgetUs;
+	v->active = true;
+	v->nextReplenish += s->model->server.periodUs;
+}
+
+/* Sporadic server: budget used by an activation comes back a period after it started */
+static void sporadicReplenish(struct simState *s, uint32_t now) {
+	struct serverState *v = &s->server;
+
+	while (v->replenishCount && v->replenishAt[0] == now) {
+		v->budget += v->replenishUs[0];
+		v->replenishCount--;
+		memmove(&v->replenishAt[0], &v->replenishAt[1], v->replenishCount * sizeof(v->replenishAt[0]));
+		memmove(&v->replenishUs[0], &v->replenishUs[1], v->replenishCount * sizeof(v->replenishUs[0]));
+	}
+}
+
+/*
+ * The polling server runs once its period starts, the deferrable and the
+ * sporadic server whenever a request waits, all while budget is left. A
+ * sporadic activation needs room for its replenishment.
+ */
+static bool serverReady(const struct simState *s) {
+	const struct simServer *server = &s->model->server;
+	const struct serverState *v = &s->server;
+
+	if (!server->enabled || !v->budget) {
+		return false;
+	}
+	if (server->kind == SIM_SERVER_POLLING) {
+		return v->active;
+	}
+	if (server->kind == SIM_SERVER_SPORADIC && !v->activation &&
+		v->replenishCount == SIM_MAX_REPLENISH) {
+		return false;
+	}
+	return v->busy || v->count;
+}
+
+/*
+ * Picks the entity to run: the most urgent ready one, the running one on a
+ * tie, otherwise the one ready the longest, as the Zephyr ready queue does.
+ * Zero time actions on the way (a job taking its mutex or blocking, the
+ * server finding its queue empty) are carried out until the pick is stable.
+ */
+static int pick(struct simState *s, int running, uint32_t now) {
+	while (1) {
+		int best = SIM_IDLE, bestPriority = INT_MAX;
+		uint32_t bestSince = 0;
+
+		for (int e = 0; e <= s->model->numTasks; e++) {
+			int priority;
+			uint32_t since;
+
+			if (e < s->model->numTasks) {
+				if (!s->tasks[e].active || s->tasks[e].blocked) {
+					continue;
+				}
+				priority = taskPriority(s, e);
+				since = s->tasks[e].readySince;
+			} else {
+				if (!serverReady(s)) {
+					continue;
+				}
+				priority = s->model->server.priority;
+				since = s->server.readySince;
+			}
+			if (priority < bestPriority ||
+				(priority == bestPriority && best != running &&
+				 (e == running || since < bestSince))) {
+				best = e;
+				bestPriority = priority;
+				bestSince = since;
+			}
+		}
+		if (best == SIM_IDLE) {
+			return best;
+		}
+		if (best == s->model->numTasks) {
+			struct serverState *v = &s->server;
+
+			if (s->model->server.kind == SIM_SERVER_SPORADIC && !v->activation) {
+				v->activation = true;
+				v->activationStart = now;
+				v->activationUsed = 0;
+			}
+			if (v->busy) {
+				return best;
+			}
+			if (!v->count) {
+				/* Nothing to serve, the budget of this period is given up */
+				v->active = false;
+				v->budget = 0;
+				s->result->server.emptyPolls++;
+				continue;
+			}
+			v->current = v->queue[v->head];
+			v->head = (v->head + 1) % SIM_MAX_QUEUE;
+			v->count--;
+			v->busy = true;
+			return best;
+		}
+		struct taskState *t = &s->tasks[best];
+		int m = segmentMutex(s, best);
+
+		t->started = true;
+		if (m < 0 || t->holds) {
+			return best;
+		}
+		if (s->owner[m] < 0) {
+			s->owner[m] = best;
+			t->holds = true;
+			return best;
+		}
+		t->blocked = true;
+	}
+}
+
+/* Request in service ran for its slice of the budget */
+static void serverRan(struct simState *s, uint32_t ran, uint32_t now) {
+	struct serverState *v = &s->server;
+	struct simServerResult *r = &s->result->server;
+
+	v->budget -= ran;
+	v->current.left -= ran;
+	v->activationUsed += ran;
+	r->busyUs += ran;
+	if (!v->current.left) {
+		uint32_t response = now - v->current.arrival;
+
+		v->busy = false;
+		r->served++;
+		r->responseSum += response;
+		r->responseMax = response > r->responseMax ? response : r->responseMax;
+	}
+	if (!v->budget) {
+		v->active = false;
+		r->exhausted++;
+	}
+	/* A sporadic activation ends when the queue is empty or the budget used up */
+	if (v->activation && (!v->budget || (!v->busy && !v->count))) {
+		v->replenishAt[v->replenishCount] = v->activationStart + s->model->server.periodUs;
+		v->replenishUs[v->replenishCount++] = v->activationUsed;
+		v->activation = false;
+	}
+}
+
+static uint32_t earlier(uint32_t a, uint32_t b) {
+	return a < b ? a : b;
+}
+
+/*
+ * @function simRun
+ *
+ * @brief Simulates the model for its duration from a synchronous release of
+ * 		  all tasks and the first server period at time 0. Mutex ceilings
+ * 		  are the most urgent priority of the tasks using them, as in
+ * 		  initMutexes() of Assignment-1.
+ */
+void simRun(const struct simModel *model, const struct simOptions *options,
+			struct simResult *result) {
+	static struct simState s;
+	uint32_t end = model->durationMs * 1000;
+	uint32_t now = 0;
+	int running = SIM_IDLE;
+
+	memset(&s, 0, sizeof(s));
+	memset(result, 0, sizeof(*result));
+	s.model = model;
+	s.options = options;
+	s.result = result;
+	for (int m = 0; m < SIM_MAX_MUTEXES; m++) {
+		s.owner[m] = -1;
+		s.ceiling[m] = INT_MAX;
+		for (int i = 0; i < model->numTasks; i++) {
+			for (int k = 0; k < model->tasks[i].numSegments; k++) {
+				if (model->tasks[i].segments[k].mutex == m && model->tasks[i].priority < s.ceiling[m]) {
+					s.ceiling[m] = model->tasks[i].priority;
+				}
+			}
+		}
+	}
+	s.server.nextReplenish = model->server.enabled && model->server.kind != SIM_SERVER_SPORADIC ?
+							 0 : UINT32_MAX;
+	s.server.budget = model->server.kind == SIM_SERVER_SPORADIC ? model->server.budgetUs : 0;
+	s.server.nextArrival = model->server.enabled ?
+						   model->server.randDist(model->server.arrivalUs, model->server.arrivalVar) :
+						   UINT32_MAX;
+	while (now < end) {
+		uint32_t next = end;
+		uint32_t job = 0;
+
+		for (int i = 0; i < model->numTasks; i++) {
+			if (s.tasks[i].nextRelease == now) {
+				release(&s, i, now);
+			}
+			next = earlier(next, s.tasks[i].nextRelease);
+		}
+		if (s.server.nextReplenish == now) {
+			replenish(&s, now);
+		}
+		sporadicReplenish(&s, now);
+		if (s.server.replenishCount) {
+			next = earlier(next, s.server.replenishAt[0]);
+		}
+		while (s.server.nextArrival == now) {
+			arrival(&s, now);
+		}
+		next = earlier(next, earlier(s.server.nextReplenish, s.server.nextArrival));
+		running = pick(&s, running, now);
+		if (running == model->numTasks) {
+			next = earlier(next, now + earlier(s.server.current.left, s.server.budget));
+			job = s.server.current.id;
+		} else if (running != SIM_IDLE) {
+			next = earlier(next, now + s.tasks[running].left);
+			job = s.tasks[running].job.seq;
+		}
+		if (options->gantt && next > now) {
+			options->gantt(options->ganttCtx, now, next, running, job);
+		}
+		if (running == model->numTasks) {
+			serverRan(&s, next - now, next);
+		} else if (running != SIM_IDLE) {
+			s.tasks[running].left -= next - now;
+			if (!s.tasks[running].left) {
+				segmentDone(&s, running, next);
+			}
+		}
+		now = next;
+	}
+	/* Jobs still running past their deadline at the end are misses too */
+	for (int i = 0; i < model->numTasks; i++) {
+		if (s.tasks[i].active && s.tasks[i].job.release + model->tasks[i].periodUs < end) {
+			result->tasks[i].misses++;
+		}
+	}
+	result->server.pending = s.server.count + s.server.busy;
+}
+
+/* Gantt output: intervals merged per entity and job, as CSV or as a chart */
+struct gantt {
+	const struct simModel *model;
+	bool csv;
+	uint32_t columnUs;				// chart resolution, 0 for no chart
+	uint32_t start, end;
+	int entity;
+	uint32_t job;
+	char chart[SIM_MAX_TASKS + 1][CHART_COLUMNS + 1];
+};
+
+static const char *entityName(const struct simModel *model, int entity) {
+	if (entity == SIM_IDLE) {
+		return "idle";
+	}
+	return entity < model->numTasks ? model->tasks[entity].name : model->server.name;
+}
+
+static void ganttFlush(struct gantt *g) {
+	if (g->end > g->start && g->csv) {
+		printf("gantt,%u,%u,%s,%u\n", g->start, g->end, entityName(g->model, g->entity),
+			   g->entity == SIM_IDLE ? 0 : g->job);
+	}
+	if (g->end > g->start && g->columnUs && g->entity != SIM_IDLE) {
+		for (uint32_t c = g->start / g->columnUs; c * g->columnUs < g->end && c < CHART_COLUMNS; c++) {
+			g->chart[g->entity][c] = '#';
+		}
+	}
+}
+
+static void ganttInterval(void *ctx, uint32_t start, uint32_t end, int entity, uint32_t job) {
+	struct gantt *g = ctx;
+
+	if (entity == g->entity && job == g->job && start == g->end) {
+		g->end = end;
+		return;
+	}
+	ganttFlush(g);
+	g->start = start;
+	g->end = end;
+	g->entity = entity;
+	g->job = job;
+}
+
+static void printChart(struct gantt *g) {
+	int rows = g->model->numTasks + g->model->server.enabled;
+
+	printf("-- Gantt chart, %u us per column\n", g->columnUs);
+	for (int e = 0; e < rows; e++) {
+		printf("--   %-10s |%s|\n", entityName(g->model, e), g->chart[e]);
+	}
+}
+
+static void printResult(const struct simModel *model, const struct simOptions *options,
+						const struct simResult *result) {
+	printf("-- Simulation of %s (%s, thresholds %s, %u ms)\n", model->title,
+		   options->inherit ? "priority inheritance" : "priority ceiling",
+		   options->thresholds ? "on" : "off", model->durationMs);
+	printf("--   %-10s %4s %4s %8s %6s %6s %6s %6s %9s %9s\n", "task", "prio", "thr", "T(us)",
+		   "jobs", "misses", "skip", "abort", "Rmax(us)", "Ravg(us)");
+	for (int i = 0; i < model->numTasks; i++) {
+		const struct simTask *task = &model->tasks[i];
+		const struct simTaskResult *r = &result->tasks[i];
+
+		printf("--   %-10s %4d %4d %8u %6u %6u %6u %6u %9u %9u\n", task->name, task->priority,
+			   task->threshold, task->periodUs, r->jobs, r->misses, r->skipped, r->aborted,
+			   r->responseMax, r->jobs ? (uint32_t)(r->responseSum / r->jobs) : 0);
+	}
+	if (model->server.enabled) {
+		const struct simServerResult *r = &result->server;
+
+		printf("-- %s server %s: priority %d, %u us every %u us\n",
+			   serverKinds[model->server.kind], model->server.name, model->server.priority,
+			   model->server.budgetUs, model->server.periodUs);
+		printf("--   %u requests, %u served, %u dropped, %u pending at the end\n",
+			   r->arrivals, r->served, r->dropped, r->pending);
+		printf("--   response max %u us, mean %u us, server busy %llu us\n", r->responseMax,
+			   r->served ? (uint32_t)(r->responseSum / r->served) : 0,
+			   (unsigned long long)r->busyUs);
+		printf("--   %u polls found no request, budget used up %u times\n",
+			   r->emptyPolls, r->exhausted);
+	}
+}
+
+/*
+ * Simulates the budgets from:to:step of the server and prints one
+ * comma separated line each, with the same requests for every budget.
+ */
+static void sweepBudget(struct simModel *model, const struct simOptions *options,
+						const char *range, unsigned seed) {
+	uint32_t from, to, step;
+	struct simResult result;
+
+	if (sscanf(range, "%u:%u:%u", &from, &to, &step) != 3 || !step) {
+		fprintf(stderr, "invalid budget range %s, expected from:to:step in us\n", range);
+		exit(2);
+	}
+	printf("sweep,budget_us,task_misses,served,dropped,mean_response_us,max_response_us\n");
+	for (uint32_t budget = from; budget <= to; budget += step) {
+		uint32_t misses = 0;
+
+		model->server.budgetUs = budget;
+		srand(seed);
+		simRun(model, options, &result);
+		for (int i = 0; i < model->numTasks; i++) {
+			misses += result.tasks[i].misses;
+		}
+		printf("sweep,%u,%u,%u,%u,%u,%u\n", budget, misses, result.server.served,
+			   result.server.dropped,
+			   result.server.served ? (uint32_t)(result.server.responseSum / result.server.served) : 0,
+			   result.server.responseMax);
+	}
+}
+
+int main(int argc, char **argv) {
+	static struct simModel model;
+	struct simOptions options = {.thresholds = true};
+	struct simResult result;
+	struct gantt g = {.entity = SIM_IDLE};
+	const char *sweep = NULL;
+	unsigned seed = 1;
+
+	/* The model first, the other options change it */
+	simLoadA1(&model);
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--p4")) {
+			simLoadA4(&model);
+		}
+	}
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--p4")) {
+			continue;
+		} else if (!strcmp(argv[i], "--inherit")) {
+			options.inherit = true;
+		} else if (!strcmp(argv[i], "--no-thresholds")) {
+			options.thresholds = false;
+		} else if (!strcmp(argv[i], "--gantt")) {
+			g.csv = true;
+		} else if (!strcmp(argv[i], "--chart") && i + 1 < argc) {
+			g.columnUs = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "--duration") && i + 1 < argc) {
+			model.durationMs = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "--server") && i + 1 < argc) {
+			model.server.kind = -1;
+			for (int k = 0; k < 3; k++) {
+				if (!strcmp(argv[i + 1], serverKinds[k])) {
+					model.server.kind = k;
+				}
+			}
+			if (model.server.kind < 0) {
+				fprintf(stderr, "unknown server %s, expected polling, deferrable or sporadic\n", argv[i + 1]);
+				return 2;
+			}
+			i++;
+		} else if (!strcmp(argv[i], "--budget") && i + 1 < argc) {
+			model.server.budgetUs = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+			seed = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "--sweep-budget") && i + 1 < argc) {
+			sweep = argv[++i];
+		} else {
+			fprintf(stderr, "usage: %s [--p4] [--inherit] [--no-thresholds] [--duration ms] "
+					"[--server polling|deferrable|sporadic] [--budget us] [--seed n] [--gantt] [--chart us] [--sweep-budget from:to:step]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+	if (sweep) {
+		if (!model.server.enabled) {
+			fprintf(stderr, "--sweep-budget needs the server of --p4\n");
+			return 2;
+		}
+		sweepBudget(&model, &options, sweep, seed);
+		return 0;
+	}
+	if (g.csv || g.columnUs) {
+		g.model = &model;
+		memset(g.chart, '.', sizeof(g.chart));
+		for (int e = 0; e <= SIM_MAX_TASKS; e++) {
+			g.chart[e][CHART_COLUMNS] = '\0';
+		}
+		options.gantt = ganttInterval;
+		options.ganttCtx = &g;
+		if (g.csv) {
+			printf("gantt,start_us,end_us,entity,job\n");
+		}
+	}
+	srand(seed);
+	simRun(&model, &options, &result);
+	if (options.gantt) {
+		ganttFlush(&g);
+	}
+	printResult(&model, &options, &result);
+	if (g.columnUs) {
+		printChart(&g);
+	}
+	return 0;
+}
@@ -0,0 +1,111 @@
+#ifndef __SIM_H__
+#define __SIM_H__
+
+/*
+ * Discrete event simulator of the periodic task sets of Assignment-1
+ * (src/task_model.h) and Assignment-4 (src/task_model_p4.h) on one CPU:
+ * fixed priority preemptive scheduling with preemption thresholds, mutex
+ * critical sections, and the polling, deferrable or sporadic server of
+ * Assignment-4 serving the aperiodic requests. Time is simulated in whole
+ * microseconds. Plain C for the host, like sched_check.c.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SIM_MAX_TASKS 16
+#define SIM_MAX_MUTEXES 8
+#define SIM_MAX_QUEUE 64		// largest aperiodic request queue
+#define SIM_MAX_REPLENISH 64	// pending replenishments of the sporadic server
+
+/* What happens to a late job, the values of task_model.h OVERRUN_* */
+#define SIM_OVERRUN_CONTINUE 0
+#define SIM_OVERRUN_SKIP 1
+#define SIM_OVERRUN_ABORT 2
+
+struct simSegment {
+	uint32_t execUs;
+	int mutex;				// mutex held for the segment, -1 for none
+};
+
+struct simTask {
+	char name[32];
+	int priority;			// lower is more urgent, like Zephyr
+	int threshold;			// priority of a started job
+	uint32_t periodUs;		// also the relative deadline
+	int overrun;			// SIM_OVERRUN_*
+	int queueDepth;			// releases kept while a job runs
+	int numSegments;
+	struct simSegment segments[3];
+};
+
+/* Servers of Assignment-4, CONFIG_APP_*_SERVER */
+#define SIM_SERVER_POLLING 0
+#define SIM_SERVER_DEFERRABLE 1
+#define SIM_SERVER_SPORADIC 2
+
+/* Aperiodic server and the requests it serves */
+struct simServer {
+	bool enabled;
+	int kind;				// SIM_SERVER_*
+	char name[32];
+	int priority;
+	uint32_t periodUs;
+	uint32_t budgetUs;
+	uint32_t arrivalUs;		// mean request interarrival time
+	float arrivalVar;
+	uint32_t execUs;		// request execution time
+	float execVar;
+	int queueDepth;			// requests waiting, further arrivals are dropped
+	uint32_t (*randDist)(int base, float var);	// the generator of the target
+};
+
+struct simModel {
+	const char *title;
+	int numTasks;
+	struct simTask tasks[SIM_MAX_TASKS];
+	int numMutexes;
+	struct simServer server;
+	uint32_t durationMs;
+};
+
+struct simOptions {
+	bool inherit;			// priority inheritance instead of the immediate ceiling
+	bool thresholds;		// started jobs run at their threshold
+	/* Called for every interval an entity runs: a task index, numTasks for the server, -1 idle */
+	void (*gantt)(void *ctx, uint32_t start, uint32_t end, int entity, uint32_t job);
+	void *ganttCtx;
+};
+
+struct simTaskResult {
+	uint32_t jobs;			// completed jobs
+	uint32_t misses;		// jobs past their deadline, aborted ones included
+	uint32_t skipped;		// releases dropped while a job ran
+	uint32_t aborted;
+	uint32_t responseMax;
+	uint64_t responseSum;
+};
+
+struct simServerResult {
+	uint32_t arrivals;
+	uint32_t served;
+	uint32_t dropped;		// arrivals at a full queue
+	uint32_t pending;		// waiting or in service at the end
+	uint32_t emptyPolls;	// polls that found no request and gave the budget up
+	uint32_t exhausted;		// times the budget was used up
+	uint32_t responseMax;
+	uint64_t responseSum;
+	uint64_t busyUs;
+};
+
+struct simResult {
+	struct simTaskResult tasks[SIM_MAX_TASKS];
+	struct simServerResult server;
+};
+
+void simLoadA1(struct simModel *model);
+void simLoadA4(struct simModel *model);
+void simRun(const struct simModel *model, const struct simOptions *options,
+			struct simResult *result);
+
+#endif // __SIM_H__
@@ -0,0 +1,43 @@
+/*
+ * @file
+ * @brief Loads the src/task_model.h set into the simulator.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "task_model.h"
+#include "sim.h"
+
+/* Jobs queued behind a running one, RELEASE_QUEUE_DEPTH of main.c */
+#define A1_QUEUE_DEPTH 4
+
+/*
+ * The tasks of the first mode, each job a compute segment, a critical
+ * section on mutex_m and a compute segment. There is no server.
+ */
+void simLoadA1(struct simModel *model) {
+	memset(model, 0, sizeof(*model));
+	model->title = "Assignment-1 task_model.h";
+	model->numMutexes = NUM_MUTEXES;
+	model->durationMs = TOTAL_TIME;
+	for (int i = 0; i < NUM_THREADS; i++) {
+		struct simTask *task = &model->tasks[model->numTasks];
+
+		if (!(modes[0].tasks & (1U << i))) {
+			continue;
+		}
+		snprintf(task->name, sizeof(task->name), "%.31s", threads[i].t_name);
+		task->priority = threads[i].priority;
+		task->threshold = threads[i].threshold;
+		task->periodUs = threads[i].period * 1000;
+		task->overrun = threads[i].overrun;
+		task->queueDepth = A1_QUEUE_DEPTH;
+		task->numSegments = 3;
+		for (int k = 0; k < 3; k++) {
+			task->segments[k].execUs = threads[i].exec_us[k];
+			task->segments[k].mutex = k == 1 ? threads[i].mutex_m : -1;
+		}
+		model->numTasks++;
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ * @file
+ * @brief Loads the Assignment-4 src/task_model_p4.h set into the simulator.
+ * @author Ashish Kumar Rambhatla.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+/*
+ * task_model_p4.h is written against Zephyr. The few kernel names it uses
+ * are stood in for here, with the request queue depth kept from its
+ * K_MSGQ_DEFINE, and its globals renamed so they do not clash with those
+ * of task_model.h.
+ */
+typedef void *k_tid_t;
+struct k_timer {
+	void *user_data;
+};
+struct k_msgq {
+	int maxMsgs;
+};
+#define K_NO_WAIT 0
+#define K_USEC(us) (us)
+#define K_MSGQ_DEFINE(name, size, depth, align) static struct k_msgq name = {depth}
+#define K_TIMER_DEFINE(name, expiry, stop) \
+	static struct k_timer name; \
+	static void (*const name##_expiry)(struct k_timer *) __attribute__((unused)) = expiry
+#define printk printf
+static inline uint32_t k_cycle_get_32(void) { return 0; }
+static inline int k_msgq_put(struct k_msgq *q, const void *data, int timeout) { return 0; }
+static inline void k_timer_start(struct k_timer *timer, int duration, int period) { }
+
+#define threads p4Threads
+#include "task_model_p4.h"
+#undef threads
+
+/* Request times drawn exactly as the request timer of the target draws them */
+static uint32_t p4RandDist(int base, float var) {
+	return rand_dist(base, var);
+}
+
+/*
+ * Every task runs one compute segment per job. A job released while the
+ * previous one runs waits on the binary semaphore of its thread, so one
+ * release is kept. The polling server serves the requests of req_msgq.
+ */
+void simLoadA4(struct simModel *model) {
+	memset(model, 0, sizeof(*model));
+	model->title = "Assignment-4 task_model_p4.h";
+	model->numTasks = NUM_THREADS;
+	model->durationMs = TOTAL_TIME;
+	for (int i = 0; i < NUM_THREADS; i++) {
+		struct simTask *task = &model->tasks[i];
+
+		snprintf(task->name, sizeof(task->name), "%.31s", p4Threads[i].t_name);
+		task->priority = p4Threads[i].priority;
+		task->threshold = p4Threads[i].threshold;
+		task->periodUs = p4Threads[i].period * 1000;
+		task->overrun = SIM_OVERRUN_CONTINUE;
+		task->queueDepth = 1;
+		task->numSegments = 1;
+		task->segments[0].execUs = p4Threads[i].exec_us;
+		task->segments[0].mutex = -1;
+	}
+	model->server.enabled = true;
+	snprintf(model->server.name, sizeof(model->server.name), "%.31s", poll_info.t_name);
+	model->server.priority = poll_info.priority;
+	model->server.periodUs = poll_info.period * 1000;
+	model->server.budgetUs = poll_info.budget * 1000;
+	model->server.arrivalUs = ARR_TIME;
+	model->server.arrivalVar = VAR_A;
+	model->server.execUs = REQ_EXEC_US;
+	model->server.execVar = VAR_R;
+	model->server.queueDepth = req_msgq.maxMsgs;
+	model->server.randDist = p4RandDist;
+}
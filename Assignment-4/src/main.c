@@ -22,8 +22,6 @@ K_MUTEX_DEFINE(activate_mutex);
  	#define DPRINTK(fmt, args...) // do nothing if not defined
 #endif
 
-#define STACK_SIZE  4096
-
 #define compiler_barrier() do { \
 	__asm__ __volatile__ ("" ::: "memory"); \
 } while (false)
@@ -39,10 +37,34 @@ static k_tid_t thread_tids[NUM_THREADS];
 static int thread_index[NUM_THREADS];
 
 static int done[NUM_THREADS];
+static volatile bool in_job[NUM_THREADS];
 static struct k_sem wait_sem[NUM_THREADS];
 
-// Support up to sixteen threads' stacks
-static K_THREAD_STACK_DEFINE(thread_stack_area, STACK_SIZE * NUM_THREADS);
+// Deadline checks and misses of every task, for the per-core miss rates
+static atomic_t deadlines[NUM_THREADS];
+static atomic_t misses[NUM_THREADS];
+
+// Partitioned scheduling: every task is pinned to one core
+#if defined(CONFIG_SCHED_CPU_MASK) && (CONFIG_MP_NUM_CPUS > 1)
+#define PARTITIONED
+#endif
+static int task_cpu[NUM_THREADS];
+
+// One stack object per task. Carving the stacks out of a single stack
+// object overlapped every stack with the guard area of the next one, so an
+// interrupt touching the top of one thread's stack faulted in the MPU.
+K_THREAD_STACK_DEFINE(thread_stack0, THREAD0_STACK_SIZE);
+K_THREAD_STACK_DEFINE(thread_stack1, THREAD1_STACK_SIZE);
+K_THREAD_STACK_DEFINE(thread_stack2, THREAD2_STACK_SIZE);
+K_THREAD_STACK_DEFINE(thread_stack3, THREAD3_STACK_SIZE);
+
+static k_thread_stack_t *const thread_stacks[NUM_THREADS] = {
+    thread_stack0, thread_stack1, thread_stack2, thread_stack3,
+};
+static const size_t thread_stack_sizes[NUM_THREADS] = {
+    K_THREAD_STACK_SIZEOF(thread_stack0), K_THREAD_STACK_SIZEOF(thread_stack1),
+    K_THREAD_STACK_SIZEOF(thread_stack2), K_THREAD_STACK_SIZEOF(thread_stack3),
+};
 
 static void timer_expiry_function(struct k_timer *timer_exp)
 {
@@ -50,10 +72,12 @@ static void timer_expiry_function(struct k_timer *timer_exp)
     int ret;
 
     ret = done[id];  
+    atomic_inc(&deadlines[id]);
     if (ret==1) {
         k_sem_give(&wait_sem[id]);
     }
     else {
+        atomic_inc(&misses[id]);
         printk("task %d misses its deadline \n", id);
         k_sem_give(&wait_sem[id]);
     }
@@ -90,17 +114,628 @@ static void thread(void *v_task_info, void *v_thread_id, void *unused)
         DPRINTK("Thread %d running task\n", thread_id);
 
         done[thread_id]=0;
+        in_job[thread_id] = true;
+        // Only tasks more urgent than the threshold preempt a running job
+        if (IS_ENABLED(CONFIG_APP_PREEMPTION_THRESHOLDS)) {
+            k_thread_priority_set(k_current_get(), task_info->threshold);
+        }
 
 		next = next + period;
-        looping(task_info->loop_iter);
+        looping_us(task_info->exec_us);
         compiler_barrier();
 
         // Sleep for period
         DPRINTK("Thread %d sleeping for %d ms\n", thread_id, task_info->period);
 
         done[thread_id]=1;
+        in_job[thread_id] = false;
+        // Back to the task priority to compete for the next release
+        if (IS_ENABLED(CONFIG_APP_PREEMPTION_THRESHOLDS)) {
+            k_thread_priority_set(k_current_get(), task_info->priority);
+        }
         k_sem_take(&wait_sem[thread_id], K_FOREVER);
     }
+    // The timer lives on this stack, it must not fire after the thread exits
+    k_timer_stop(&task_timer);
+}
+
+#if defined(CONFIG_APP_COUNT_SWITCHES)
+// Context switches into every task thread, and the preemptions among them:
+// switches into a thread in the middle of a job. Counted by the switch hook
+// with interrupts locked, read after the run.
+static uint32_t switches[NUM_THREADS];
+static uint32_t preemptions[NUM_THREADS];
+
+static void count_switch(struct k_thread *thread)
+{
+    for (int i = 0; i < NUM_THREADS; i++) {
+        if (thread == &thread_structs[i]) {
+            switches[i]++;
+            preemptions[i] += in_job[i];
+            return;
+        }
+    }
+}
+
+// Print the switches of every task, to compare runs with and without the
+// preemption thresholds (CONFIG_APP_PREEMPTION_THRESHOLDS)
+static void print_switches(void)
+{
+    uint32_t total_switches = 0, total_preemptions = 0;
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        printk("%s: threshold %d, %u context switches, %u preemptions\n", threads[i].t_name,
+               IS_ENABLED(CONFIG_APP_PREEMPTION_THRESHOLDS) ? threads[i].threshold :
+               threads[i].priority, switches[i], preemptions[i]);
+        total_switches += switches[i];
+        total_preemptions += preemptions[i];
+    }
+    printk("thresholds %s: %u context switches, %u preemptions\n",
+           IS_ENABLED(CONFIG_APP_PREEMPTION_THRESHOLDS) ? "on" : "off",
+           total_switches, total_preemptions);
+}
+#endif
+
+// Aperiodic server, selected by CONFIG_APP_POLLING_SERVER,
+// CONFIG_APP_DEFERRABLE_SERVER or CONFIG_APP_SPORADIC_SERVER. All of them run
+// as one thread at poll_info.priority with the budget and period of
+// poll_info, and serve the requests of req_msgq in arrival order.
+// poll_info.left_budget is the budget left in nanoseconds.
+#if defined(CONFIG_APP_DEFERRABLE_SERVER)
+#define SERVER_KIND "deferrable"
+#elif defined(CONFIG_APP_SPORADIC_SERVER)
+#define SERVER_KIND "sporadic"
+#else
+#define SERVER_KIND "polling"
+#endif
+
+static struct k_thread server_struct;
+K_THREAD_STACK_DEFINE(server_stack, POLL_STACK_SIZE);
+
+static struct k_timer server_timer;     // periodic replenishment
+static struct k_sem server_sem;         // given at every replenishment
+static struct k_spinlock budget_lock;
+
+// Budget taken from poll_info.left_budget since the start, in nanoseconds.
+// The sporadic server gives back the difference over an activation.
+static uint64_t charged_ns;
+
+// Request in service, a request can span several budgets
+static struct req_type cur_req;
+static bool cur_busy;
+static uint32_t cur_left_us;
+
+// Histograms of the served requests in HIST_BUCKET_US buckets, the last
+// bucket counting everything beyond, the same for every server
+#define HIST_BUCKETS   100
+#define HIST_BUCKET_US 2000
+
+struct histogram {
+    uint32_t count;
+    uint64_t sum_us;
+    uint32_t max_us;
+    uint32_t buckets[HIST_BUCKETS + 1];
+};
+
+static struct histogram response_hist;      // arrival to completion
+static struct histogram queueing_hist;      // arrival to the start of service
+
+static void hist_add(struct histogram *hist, uint32_t us)
+{
+    hist->count++;
+    hist->sum_us += us;
+    hist->max_us = MAX(hist->max_us, us);
+    hist->buckets[MIN(us / HIST_BUCKET_US, HIST_BUCKETS)]++;
+}
+
+// Upper edge of the bucket holding the given percentile, the largest sample
+// when that is in the last bucket or smaller than the edge
+static uint32_t hist_percentile(const struct histogram *hist, int percent)
+{
+    uint32_t rank = ((uint64_t)hist->count * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += hist->buckets[b];
+        if (rank && seen >= rank) {
+            return MIN((uint32_t)(b + 1) * HIST_BUCKET_US, hist->max_us);
+        }
+    }
+    return hist->max_us;
+}
+
+static void hist_print(const struct shell *shell, const char *name,
+                       const struct histogram *hist)
+{
+    shell_print(shell, "%-15s count %u, mean %u us, p50 %u us, p95 %u us, p99 %u us, max %u us",
+                name, hist->count, hist->count ? (uint32_t)(hist->sum_us / hist->count) : 0,
+                hist_percentile(hist, 50), hist_percentile(hist, 95), hist_percentile(hist, 99),
+                hist->max_us);
+}
+
+// Take up to ns from the budget, with budget_lock held
+static void budget_take(uint64_t ns)
+{
+    uint64_t take = MIN(ns, (uint64_t)poll_info.left_budget);
+
+    poll_info.left_budget -= take;
+    charged_ns += take;
+}
+
+#if defined(CONFIG_APP_SERVER_BUDGET_ENFORCEMENT)
+// The server is accounted from the context switch hooks of the kernel with
+// the cycle counter, preemptions included, and moved to BACKGROUND_PRIO by
+// budget_timer when the budget runs out. It gets its priority back with the
+// next replenishment.
+#define BACKGROUND_PRIO K_LOWEST_APPLICATION_THREAD_PRIO
+
+static struct k_timer budget_timer;
+static bool server_on_cpu;
+static bool server_demoted;
+static uint32_t demotions;              // budgets used up
+
+// Charge the time the server has been running since it was switched in or
+// since the last settle, with budget_lock held
+static void budget_settle(void)
+{
+    uint32_t now = k_cycle_get_32();
+
+    if (server_on_cpu) {
+        budget_take(k_cyc_to_ns_floor64(now - poll_info.last_switched_in));
+        poll_info.last_switched_in = now;
+    }
+}
+
+static void budget_switched_in(struct k_thread *thread)
+{
+    if (thread == poll_info.poll_tid) {
+        k_spinlock_key_t key = k_spin_lock(&budget_lock);
+
+        poll_info.last_switched_in = k_cycle_get_32();
+        server_on_cpu = true;
+        k_spin_unlock(&budget_lock, key);
+    }
+}
+
+static void budget_switched_out(struct k_thread *thread)
+{
+    if (thread == poll_info.poll_tid) {
+        k_spinlock_key_t key = k_spin_lock(&budget_lock);
+
+        budget_settle();
+        server_on_cpu = false;
+        k_spin_unlock(&budget_lock, key);
+    }
+}
+
+// Fires when the budget left at arming would be used up. Time the server
+// was preempted is not charged, so the timer is armed again for what is
+// left until the budget is really gone.
+static void budget_expiry_function(struct k_timer *timer_exp)
+{
+    k_spinlock_key_t key = k_spin_lock(&budget_lock);
+    bool demote;
+    int left;
+
+    budget_settle();
+    left = poll_info.left_budget;
+    demote = !left && !server_demoted;
+    server_demoted = server_demoted || demote;
+    k_spin_unlock(&budget_lock, key);
+    if (left) {
+        k_timer_start(&budget_timer, K_NSEC(left), K_NO_WAIT);
+    } else if (demote) {
+        demotions++;
+        k_thread_priority_set(poll_info.poll_tid, BACKGROUND_PRIO);
+    }
+}
+
+static void budget_arm(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&budget_lock);
+    int left = poll_info.left_budget;
+
+    k_spin_unlock(&budget_lock, key);
+    if (left) {
+        k_timer_start(&budget_timer, K_NSEC(left), K_NO_WAIT);
+    }
+}
+#else
+static void budget_settle(void)
+{
+}
+#endif
+
+// User tracing hooks of the kernel, called on every context switch
+#if defined(CONFIG_APP_COUNT_SWITCHES) || defined(CONFIG_APP_SERVER_BUDGET_ENFORCEMENT)
+void sys_trace_thread_switched_in_user(struct k_thread *thread)
+{
+#if defined(CONFIG_APP_COUNT_SWITCHES)
+    count_switch(thread);
+#endif
+#if defined(CONFIG_APP_SERVER_BUDGET_ENFORCEMENT)
+    budget_switched_in(thread);
+#endif
+}
+#endif
+
+#if defined(CONFIG_APP_SERVER_BUDGET_ENFORCEMENT)
+void sys_trace_thread_switched_out_user(struct k_thread *thread)
+{
+    budget_switched_out(thread);
+}
+#endif
+
+static uint32_t budget_us(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&budget_lock);
+    uint32_t left;
+
+    budget_settle();
+    left = poll_info.left_budget / 1000;
+    k_spin_unlock(&budget_lock, key);
+    return left;
+}
+
+static uint64_t budget_charged(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&budget_lock);
+    uint64_t charged;
+
+    budget_settle();
+    charged = charged_ns;
+    k_spin_unlock(&budget_lock, key);
+    return charged;
+}
+
+// Polling server: the budget left when the queue runs empty is lost
+static void budget_discard(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&budget_lock);
+
+    poll_info.left_budget = 0;
+    k_spin_unlock(&budget_lock, key);
+}
+
+static void budget_add(int ns)
+{
+    k_spinlock_key_t key = k_spin_lock(&budget_lock);
+
+    budget_settle();
+    poll_info.left_budget = MIN(poll_info.left_budget + ns, 1000000 * poll_info.budget);
+#if defined(CONFIG_APP_SERVER_BUDGET_ENFORCEMENT)
+    if (server_demoted) {
+        server_demoted = false;
+        k_spin_unlock(&budget_lock, key);
+        k_thread_priority_set(poll_info.poll_tid, poll_info.priority);
+        budget_arm();
+        return;
+    }
+#endif
+    k_spin_unlock(&budget_lock, key);
+}
+
+// Polling and deferrable server: full budget at the start of every period
+static void server_expiry_function(struct k_timer *timer_exp)
+{
+    budget_add(1000000 * poll_info.budget);
+    k_sem_give(&server_sem);
+}
+
+// Make sure a request is in service, waiting for one up to timeout
+static bool get_request(k_timeout_t timeout)
+{
+    if (!cur_busy) {
+        if (k_msgq_get(&req_msgq, &cur_req, timeout)) {
+            return false;
+        }
+        cur_left_us = cur_req.exec_us;
+        cur_busy = true;
+        hist_add(&queueing_hist, k_cyc_to_us_floor32(k_cycle_get_32() - cur_req.arr_time));
+    }
+    return true;
+}
+
+// Serve the request in service and return the budget it took in
+// nanoseconds. With budget enforcement the whole request runs, in the
+// background once budget_timer finds the budget used up. Otherwise it runs
+// for as long as the budget lasts and is charged its execution time, so
+// preemptions by the tasks are not charged to the server.
+static uint32_t serve_slice(void)
+{
+    uint64_t before = budget_charged();
+
+#if defined(CONFIG_APP_SERVER_BUDGET_ENFORCEMENT)
+    budget_arm();
+    looping_us(cur_left_us);
+    compiler_barrier();
+    k_timer_stop(&budget_timer);
+    cur_left_us = 0;
+#else
+    uint32_t slice = MIN(cur_left_us, budget_us());
+    k_spinlock_key_t key;
+
+    looping_us(slice);
+    compiler_barrier();
+    key = k_spin_lock(&budget_lock);
+    budget_take(1000ULL * slice);
+    k_spin_unlock(&budget_lock, key);
+    cur_left_us -= slice;
+#endif
+    if (!cur_left_us) {
+        hist_add(&response_hist, k_cyc_to_us_floor32(k_cycle_get_32() - cur_req.arr_time));
+        cur_busy = false;
+    }
+    return (uint32_t)(budget_charged() - before);
+}
+
+#if defined(CONFIG_APP_SPORADIC_SERVER)
+// Pending replenishments of the sporadic server, the amount in nanoseconds
+// per timer, 0 when the timer is free
+static struct k_timer replenish_timers[CONFIG_APP_SPORADIC_REPLENISHMENTS];
+static atomic_t replenish_amount[CONFIG_APP_SPORADIC_REPLENISHMENTS];
+
+static void replenish_expiry_function(struct k_timer *timer_exp)
+{
+    int slot = timer_exp - replenish_timers;
+
+    budget_add(atomic_set(&replenish_amount[slot], 0));
+    k_sem_give(&server_sem);
+}
+
+static int replenish_slot(void)
+{
+    for (int i = 0; i < CONFIG_APP_SPORADIC_REPLENISHMENTS; i++) {
+        if (!atomic_get(&replenish_amount[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Give the budget used by an activation back one period after it started
+static void replenish_schedule(int slot, uint32_t start, uint32_t used_ns)
+{
+    uint32_t elapsed_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+    uint32_t period_us = 1000 * poll_info.period;
+
+    atomic_set(&replenish_amount[slot], used_ns);
+    k_timer_start(&replenish_timers[slot],
+                  K_USEC(period_us > elapsed_us ? period_us - elapsed_us : 0), K_NO_WAIT);
+}
+
+// Sporadic server: serves as soon as a request arrives while budget is left.
+// An activation lasts until the queue is empty or the budget used up, and
+// the budget it used comes back one period after it started, so the server
+// never takes more than its budget in any window of one period.
+static void server(void)
+{
+    uint32_t start = 0, used = 0;
+    int slot = -1;
+
+    for (int i = 0; i < CONFIG_APP_SPORADIC_REPLENISHMENTS; i++) {
+        k_timer_init(&replenish_timers[i], replenish_expiry_function, NULL);
+    }
+    while (running) {
+        if (!budget_us() || !get_request(used ? K_NO_WAIT : K_MSEC(poll_info.period))) {
+            if (used) {
+                replenish_schedule(slot, start, used);
+                used = 0;
+            }
+            if (!budget_us()) {
+                k_sem_take(&server_sem, K_MSEC(poll_info.period));
+            }
+            continue;
+        }
+        if (!used) {
+            // Every activation needs a timer for its replenishment
+            slot = replenish_slot();
+            if (slot < 0) {
+                k_sem_take(&server_sem, K_MSEC(poll_info.period));
+                continue;
+            }
+            start = k_cycle_get_32();
+        }
+        used += serve_slice();
+    }
+    for (int i = 0; i < CONFIG_APP_SPORADIC_REPLENISHMENTS; i++) {
+        k_timer_stop(&replenish_timers[i]);
+    }
+}
+#elif defined(CONFIG_APP_DEFERRABLE_SERVER)
+// Deferrable server: keeps the budget it does not use until the end of the
+// period and serves a request as soon as it arrives while budget is left
+static void server(void)
+{
+    while (running) {
+        if (!budget_us()) {
+            k_sem_take(&server_sem, K_MSEC(poll_info.period));
+            continue;
+        }
+        if (get_request(K_MSEC(poll_info.period))) {
+            serve_slice();
+        }
+    }
+}
+#else
+// Polling server: at the start of every period serves the queued requests
+// until the queue is empty or the budget used up. The budget left when the
+// queue runs empty is lost, a request arriving after the poll waits for the
+// next period.
+static void server(void)
+{
+    while (running) {
+        k_sem_take(&server_sem, K_FOREVER);
+        while (running && budget_us() && get_request(K_NO_WAIT)) {
+            serve_slice();
+        }
+        budget_discard();
+    }
+}
+#endif
+
+static void server_thread(void *unused1, void *unused2, void *unused3)
+{
+    server();
+}
+
+// Start the aperiodic server and the request generator
+static void start_server(void)
+{
+    k_sem_init(&server_sem, 0, 1);
+    k_timer_init(&server_timer, server_expiry_function, NULL);
+#if defined(CONFIG_APP_SERVER_BUDGET_ENFORCEMENT)
+    k_timer_init(&budget_timer, budget_expiry_function, NULL);
+#endif
+    poll_info.left_budget = 1000000 * poll_info.budget;
+    poll_info.poll_tid = k_thread_create(&server_struct, server_stack,
+                                         K_THREAD_STACK_SIZEOF(server_stack),
+                                         server_thread, NULL, NULL, NULL,
+                                         poll_info.priority, 0, K_FOREVER);
+    k_thread_name_set(poll_info.poll_tid, poll_info.t_name);
+    k_thread_start(poll_info.poll_tid);
+#if !defined(CONFIG_APP_SPORADIC_SERVER)
+    k_timer_start(&server_timer, K_NO_WAIT, K_MSEC(poll_info.period));
+#endif
+    k_timer_start(&req_timer, K_USEC(rand_dist(ARR_TIME, VAR_A)), K_NO_WAIT);
+}
+
+static void stop_server(void)
+{
+    k_timer_stop(&req_timer);
+    k_timer_stop(&server_timer);
+    k_sem_give(&server_sem);
+    k_thread_join(&server_struct, K_FOREVER);
+#if defined(CONFIG_APP_SERVER_BUDGET_ENFORCEMENT)
+    k_timer_stop(&budget_timer);
+#endif
+}
+
+// Print the aperiodic response times and queueing delays, the same way for
+// every server, after a run and from the "aperiodic" shell command
+static void print_aperiodic(const struct shell *shell)
+{
+    shell_print(shell, "%s server: %d requests, %u served, %d dropped on a full req_msgq",
+                SERVER_KIND, total_req, response_hist.count, dropped_req);
+    hist_print(shell, "response time:", &response_hist);
+    hist_print(shell, "queueing delay:", &queueing_hist);
+#if defined(CONFIG_APP_SERVER_BUDGET_ENFORCEMENT)
+    shell_print(shell, "%s server: budget used up %u times, %u us charged", SERVER_KIND,
+                demotions, (uint32_t)(charged_ns / 1000));
+#endif
+}
+
+#define CALIBRATION_LOOPS 100000
+#define CALIBRATION_RUNS  5
+
+// Measure looping() iterations per millisecond with the timing API, keeping
+// the fastest of a few runs executed with interrupts locked
+static void calibrate_looping(void)
+{
+    uint64_t ns, best_ns = UINT64_MAX;
+    timing_t start, end;
+    unsigned int key;
+
+    timing_init();
+    timing_start();
+    for (int i = 0; i < CALIBRATION_RUNS; i++) {
+        key = irq_lock();
+        start = timing_counter_get();
+        looping(CALIBRATION_LOOPS);
+        end = timing_counter_get();
+        irq_unlock(key);
+
+        ns = timing_cycles_to_ns(timing_cycles_get(&start, &end));
+        best_ns = MIN(best_ns, ns);
+    }
+    loops_per_ms = (uint32_t)((uint64_t)CALIBRATION_LOOPS * 1000000 / MAX(best_ns, 1));
+    printk("looping(): %u iterations per millisecond\n", loops_per_ms);
+}
+
+#ifdef PARTITIONED
+// Assign every task to a core by worst-fit decreasing utilization: in order of
+// decreasing utilization each task goes to the least loaded core that stays
+// within the hyperbolic bound prod(U+1) <= 2, or to the least loaded core
+// when none does. Utilizations are in parts per million.
+static void partition_tasks(void)
+{
+    uint64_t load[CONFIG_MP_NUM_CPUS] = {0};
+    uint64_t product[CONFIG_MP_NUM_CPUS];
+    bool placed[NUM_THREADS] = {false};
+
+    for (int c = 0; c < CONFIG_MP_NUM_CPUS; c++) {
+        product[c] = 1000000;
+    }
+    for (int k = 0; k < NUM_THREADS; k++) {
+        int i = -1, target = -1, lightest = 0;
+        uint64_t util = 0;
+
+        for (int j = 0; j < NUM_THREADS; j++) {
+            uint64_t u = (uint64_t)threads[j].exec_us * 1000 / threads[j].period;
+            if (!placed[j] && (i < 0 || u > util)) {
+                i = j;
+                util = u;
+            }
+        }
+        for (int c = 0; c < CONFIG_MP_NUM_CPUS; c++) {
+            bool fits = product[c] * (1000000 + util) / 1000000 <= 2000000;
+            if (fits && (target < 0 || load[c] < load[target])) {
+                target = c;
+            }
+            if (load[c] < load[lightest]) {
+                lightest = c;
+            }
+        }
+        if (target < 0) {
+            printk("task %d fits on no core, placed on cpu %d\n", i, lightest);
+            target = lightest;
+        }
+        task_cpu[i] = target;
+        placed[i] = true;
+        load[target] += util;
+        product[target] = product[target] * (1000000 + util) / 1000000;
+    }
+}
+#endif
+
+// Print the deadline miss rate of every core
+static void print_core_misses(void)
+{
+    for (int c = 0; c < CONFIG_MP_NUM_CPUS; c++) {
+        uint32_t checks = 0, missed = 0, rate;
+
+        for (int i = 0; i < NUM_THREADS; i++) {
+            if (task_cpu[i] == c) {
+                checks += atomic_get(&deadlines[i]);
+                missed += atomic_get(&misses[i]);
+            }
+        }
+        rate = checks ? missed * 10000 / checks : 0;
+        printk("cpu %d: %u deadlines, %u misses, miss rate %u.%02u%%\n",
+               c, checks, missed, rate / 100, rate % 100);
+    }
+}
+
+// Print the peak stack usage of every task, measured from the part of its
+// stack still holding the CONFIG_INIT_STACKS fill pattern, followed by the
+// stack sizes to use in task_model_p4.h
+static void print_stack_usage(void)
+{
+    size_t unused, used[NUM_THREADS];
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        if (k_thread_stack_space_get(&thread_structs[i], &unused)) {
+            unused = 0;
+        }
+        used[i] = thread_stack_sizes[i] - unused;
+        printk("%s: stack peak %u of %u bytes%s\n", threads[i].t_name, (unsigned)used[i],
+               (unsigned)thread_stack_sizes[i], unused ? "" : ", may have overflowed");
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        size_t size = used[i] + used[i] * STACK_MARGIN / 100;
+        printk("#define THREAD%d_STACK_SIZE  %u\n", i,
+               (unsigned)ROUND_UP(MAX(size, (size_t)STACK_ALIGN), STACK_ALIGN));
+    }
 }
 
 // Start all threads defined in the task set
@@ -112,20 +747,28 @@ static void start_threads(void)
         done[i]=0;
     }
 
-    // Small delay to make sure we set each thread's name before it runs
+#ifdef PARTITIONED
+    partition_tasks();
+#endif
+
+    // Threads are created suspended so that the name and the CPU mask are
+    // set before they run
 
     // Start each thread
     for (int i = 0; i < NUM_THREADS; i++) {
 		thread_index[i]=i;
         thread_tids[i] = k_thread_create(&thread_structs[i],
-                                         &thread_stack_area[STACK_SIZE * i],
-                                         STACK_SIZE * sizeof(k_thread_stack_t),
+                                         thread_stacks[i], thread_stack_sizes[i],
                                          thread, (void *)&threads[i],
                                          (void *)&thread_index[i], NULL, threads[i].priority,
-                                         0, K_MSEC(10));
+                                         0, K_FOREVER);
 
         k_thread_name_set(thread_tids[i], threads[i].t_name);
-
+#ifdef PARTITIONED
+        k_thread_cpu_mask_clear(thread_tids[i]);
+        k_thread_cpu_mask_enable(thread_tids[i], task_cpu[i]);
+#endif
+        k_thread_start(thread_tids[i]);
     }
     printk("Threads Initialized!\n");
 }
@@ -133,7 +776,8 @@ static void start_threads(void)
 // "Entry point" of our code
 void main(void)
 {
-
+    // Measure the speed of looping() before any task runs
+    calibrate_looping();
 
     // Spawn the threads
     start_threads();
@@ -145,9 +789,11 @@ void main(void)
     //k_condvar_wait(&activate_signal, &activate_mutex, K_FOREVER);
     k_mutex_unlock(&activate_mutex);
 
+    start_server();
     k_sleep(K_MSEC(TOTAL_TIME));
     // Stop the threads!
     running = false;
+    stop_server();
 
     //terminate waiting threads waiting on semaphore
     for (int i = 0; i < NUM_THREADS; ++i) {
@@ -160,6 +806,12 @@ void main(void)
     }
 
     printk("Stopped threads\n");
+    print_aperiodic(shell_backend_uart_get_ptr());
+    print_core_misses();
+#if defined(CONFIG_APP_COUNT_SWITCHES)
+    print_switches();
+#endif
+    print_stack_usage();
 
 }
 
@@ -177,4 +829,15 @@ static int activate_function(const struct shell *shell,
     return 0;
 }
 
+static int aperiodic_function(const struct shell *shell,
+                              size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    print_aperiodic(shell);
+    return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(aperiodic, NULL, "Print the aperiodic response times", aperiodic_function, 1, 0);
 SHELL_CMD_ARG_REGISTER(activate, NULL, "Activate to start program", activate_function,1,0);
\ No newline at end of file
@@ -17,8 +17,6 @@
 	__asm__ __volatile__ ("" ::: "memory"); \
 } while (false)
 
-#define STACK_SIZE  4096
-
 #define NUM_THREADS	4		// number of threads
 #define TOTAL_TIME 30000  	// total execution time in milliseconds
 #define MAX_RECORD 150
@@ -28,16 +26,31 @@ struct task_s           // struct for periodic task
 	char t_name[32]; 	// task name
 	int priority; 		// priority of the task
 	int period; 		// period for periodic task in milliseconds
-	int loop_iter; 	   // loop iterations for compute
+	int exec_us; 	   // execution time of compute in microseconds
+	int threshold;     // preemption threshold, the priority a released job runs at
 };
 
-#define THREAD0 {"task00", 5, 50, 1680000}
-#define THREAD1 {"task11", 8, 160, 3500000}
-#define THREAD2 {"task22", 9, 220, 3640000}
-#define THREAD3 {"task33", 10, 360, 3640000}
+// Preemption thresholds are the largest that keep the set, including the
+// polling server as a periodic task of its budget, schedulable under the
+// preemption threshold response time analysis of Assignment-1
+// (schedAssignThresholds). All tasks form one non-preemptive group.
+#define THREAD0 {"task00", 5, 50, 10500, 5}
+#define THREAD1 {"task11", 8, 160, 21875, 5}
+#define THREAD2 {"task22", 9, 220, 22750, 5}
+#define THREAD3 {"task33", 10, 360, 22750, 5}
 
 struct task_s threads[NUM_THREADS]={THREAD0, THREAD1, THREAD2, THREAD3};
 
+// Stack size of every task thread in bytes. After a run main() prints the
+// peak stack usage of every task and sizes with STACK_MARGIN percent added,
+// as lines to paste here.
+#define THREAD0_STACK_SIZE  4096
+#define THREAD1_STACK_SIZE  4096
+#define THREAD2_STACK_SIZE  4096
+#define THREAD3_STACK_SIZE  4096
+#define STACK_MARGIN 25     // percent added to the peak usage
+#define STACK_ALIGN  64     // suggested sizes are rounded up to this
+
 struct task_aps         // struct for polling server
 {
 	char t_name[32]; 	// task name
@@ -51,12 +64,13 @@ struct task_aps         // struct for polling server
 
 #define POLL_PRIO   6
 #define BUDGET 30       // execution budget for polling server in milliseconds
+#define POLL_STACK_SIZE 2048
 
 struct task_aps poll_info = {"polling_t", POLL_PRIO, 120, BUDGET, NULL, 0, 1000000*BUDGET};
 
 struct req_type {       // struct for aperiodic requests
     uint32_t id;
-    uint32_t iterations;    // loop iterations for compute
+    uint32_t exec_us;       // execution time of the request in microseconds
     uint32_t arr_time;      // the arrival time of the request
 };
 
@@ -79,6 +93,15 @@ void looping(int loop_count)
     compiler_barrier();
 }
 
+// looping() iterations per millisecond, measured at boot by calibrate_looping()
+uint32_t loops_per_ms;
+
+// Execute for exec_us microseconds of CPU time
+void looping_us(uint32_t exec_us)
+{
+    looping((int)((uint64_t)exec_us * loops_per_ms / 1000));
+}
+
 // generate random number between base*(1-var) and base
 static uint32_t rand_dist(int base, float var)  
 {
@@ -110,8 +133,9 @@ uint64_t sub32(uint32_t start, uint32_t end)
 }
 
 #define ARR_TIME 15000      // interarrival time of aperiodic requests in microseconds
-#define REQ_LOOP 420000     // aperiodic request loop count
+#define REQ_EXEC_US 2625    // aperiodic request execution time in microseconds
 int total_req=0;
+int dropped_req=0;      // requests lost because req_msgq was full
 
 // Timer allback function to generate aperiodic requests
 static void req_expiry_function(struct k_timer *timer_exp)
@@ -120,9 +144,11 @@ static void req_expiry_function(struct k_timer *timer_exp)
     struct req_type data;
 
     data.id = total_req;
-    data.iterations = rand_dist(REQ_LOOP, VAR_R);
+    data.exec_us = rand_dist(REQ_EXEC_US, VAR_R);
     data.arr_time = k_cycle_get_32();
-    k_msgq_put(&req_msgq, &data, K_NO_WAIT);
+    if (k_msgq_put(&req_msgq, &data, K_NO_WAIT)) {
+        dropped_req++;
+    }
     
     total_req++;
 
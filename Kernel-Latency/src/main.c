@@ -0,0 +1,242 @@
+#include <zephyr.h>
+#include <kernel.h>
+#include <sys/printk.h>
+#include <sys/util.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <shell/shell.h>
+
+// Measures the kernel paths the assignment applications rely on with the
+// cycle counter, over many iterations, and prints min/avg/max of each:
+//   timer isr -> sem wakeup   k_timer expiry giving a semaphore until the
+//                             waiting thread runs (timer_expiry_function of
+//                             Assignment-4)
+//   timer status sync         k_timer expiry until k_timer_status_sync()
+//                             returns (the release loop of Assignment-1)
+//   mutex handoff             k_mutex_unlock() by a lower priority holder
+//                             until the blocked k_mutex_lock() returns
+//   msgq put in isr           cost of k_msgq_put() in a k_timer expiry
+//                             (req_expiry_function of Assignment-4)
+//   msgq isr -> get wakeup    that put until the waiting k_msgq_get() returns
+
+#define ITERATIONS   1000   // samples per path by default
+#define WARMUP       10     // first samples not counted, cold caches
+#define BENCH_PRIO   2      // measuring thread
+#define HOLDER_PRIO  3      // lower priority mutex holder
+#define TIMER_US     500    // timer expiry after the measuring thread waits
+#define STACK_SIZE   2048
+
+struct lat_stats {
+    const char *name;
+    uint32_t samples;
+    uint32_t min;           // cycles
+    uint32_t max;
+    uint64_t sum;
+};
+
+enum {
+    PATH_SEM_WAKEUP,
+    PATH_STATUS_SYNC,
+    PATH_MUTEX_HANDOFF,
+    PATH_MSGQ_PUT,
+    PATH_MSGQ_WAKEUP,
+    NUM_PATHS
+};
+
+static struct lat_stats stats[NUM_PATHS] = {
+    {"timer isr -> sem wakeup"},
+    {"timer status sync"},
+    {"mutex handoff"},
+    {"msgq put in isr"},
+    {"msgq isr -> get wakeup"},
+};
+
+// Cycle stamps taken in the timer expiry functions and by the mutex holder
+static volatile uint32_t isr_stamp;
+static volatile uint32_t put_cycles;
+
+// Defined statically, the threads below start before main() runs
+static struct k_timer lat_timer;
+K_SEM_DEFINE(wake_sem, 0, 1);
+K_SEM_DEFINE(held_sem, 0, 1);
+K_SEM_DEFINE(hold_sem, 0, 1);
+K_MUTEX_DEFINE(lat_mutex);
+K_MSGQ_DEFINE(lat_msgq, sizeof(uint32_t), 4, 4);
+
+static int iterations = ITERATIONS;
+K_SEM_DEFINE(run_sem, 0, 1);
+
+static void stats_reset(void)
+{
+    for (int p = 0; p < NUM_PATHS; p++) {
+        stats[p].samples = 0;
+        stats[p].min = UINT32_MAX;
+        stats[p].max = 0;
+        stats[p].sum = 0;
+    }
+}
+
+// Count a sample once the warm-up iterations are over
+static void stats_add(int path, int iteration, uint32_t cycles)
+{
+    struct lat_stats *s = &stats[path];
+
+    if (iteration < WARMUP) {
+        return;
+    }
+    s->samples++;
+    s->sum += cycles;
+    s->min = MIN(s->min, cycles);
+    s->max = MAX(s->max, cycles);
+}
+
+static void sem_expiry_function(struct k_timer *timer_exp)
+{
+    isr_stamp = k_cycle_get_32();
+    k_sem_give(&wake_sem);
+}
+
+static void sync_expiry_function(struct k_timer *timer_exp)
+{
+    isr_stamp = k_cycle_get_32();
+}
+
+static void msgq_expiry_function(struct k_timer *timer_exp)
+{
+    uint32_t start = k_cycle_get_32();
+
+    isr_stamp = start;
+    k_msgq_put(&lat_msgq, &start, K_NO_WAIT);
+    put_cycles = k_cycle_get_32() - start;
+}
+
+static void bench_sem_wakeup(void)
+{
+    k_timer_init(&lat_timer, sem_expiry_function, NULL);
+    for (int i = 0; i < iterations + WARMUP; i++) {
+        k_timer_start(&lat_timer, K_USEC(TIMER_US), K_NO_WAIT);
+        k_sem_take(&wake_sem, K_FOREVER);
+        stats_add(PATH_SEM_WAKEUP, i, k_cycle_get_32() - isr_stamp);
+    }
+}
+
+static void bench_status_sync(void)
+{
+    k_timer_init(&lat_timer, sync_expiry_function, NULL);
+    k_timer_start(&lat_timer, K_USEC(TIMER_US), K_USEC(TIMER_US));
+    for (int i = 0; i < iterations + WARMUP; i++) {
+        k_timer_status_sync(&lat_timer);
+        stats_add(PATH_STATUS_SYNC, i, k_cycle_get_32() - isr_stamp);
+    }
+    k_timer_stop(&lat_timer);
+}
+
+static void bench_msgq(void)
+{
+    uint32_t start;
+
+    k_timer_init(&lat_timer, msgq_expiry_function, NULL);
+    for (int i = 0; i < iterations + WARMUP; i++) {
+        k_timer_start(&lat_timer, K_USEC(TIMER_US), K_NO_WAIT);
+        k_msgq_get(&lat_msgq, &start, K_FOREVER);
+        stats_add(PATH_MSGQ_WAKEUP, i, k_cycle_get_32() - start);
+        stats_add(PATH_MSGQ_PUT, i, put_cycles);
+    }
+}
+
+// Takes the mutex for the measuring thread, then releases it once that
+// thread blocks on it
+static void holder(void *unused1, void *unused2, void *unused3)
+{
+    while (1) {
+        k_sem_take(&hold_sem, K_FOREVER);
+        k_mutex_lock(&lat_mutex, K_FOREVER);
+        // The measuring thread preempts here and blocks on the mutex
+        k_sem_give(&held_sem);
+        isr_stamp = k_cycle_get_32();
+        k_mutex_unlock(&lat_mutex);
+    }
+}
+
+K_THREAD_DEFINE(holder_tid, STACK_SIZE, holder, NULL, NULL, NULL, HOLDER_PRIO, 0, 0);
+
+static void bench_mutex_handoff(void)
+{
+    for (int i = 0; i < iterations + WARMUP; i++) {
+        k_sem_give(&hold_sem);
+        k_sem_take(&held_sem, K_FOREVER);
+        k_mutex_lock(&lat_mutex, K_FOREVER);
+        stats_add(PATH_MUTEX_HANDOFF, i, k_cycle_get_32() - isr_stamp);
+        k_mutex_unlock(&lat_mutex);
+    }
+}
+
+static uint32_t cycles_to_ns(uint64_t cycles)
+{
+    return (uint32_t)k_cyc_to_ns_floor64(cycles);
+}
+
+// Print every path, and one comma separated line each to grep for when
+// comparing Zephyr versions or boards
+static void print_stats(void)
+{
+    printk("%-24s %8s %10s %10s %10s\n", "path", "samples", "min(ns)", "avg(ns)", "max(ns)");
+    for (int p = 0; p < NUM_PATHS; p++) {
+        struct lat_stats *s = &stats[p];
+        uint64_t avg = s->samples ? s->sum / s->samples : 0;
+
+        printk("%-24s %8u %10u %10u %10u\n", s->name, s->samples,
+               cycles_to_ns(s->min), cycles_to_ns(avg), cycles_to_ns(s->max));
+    }
+    printk("latency,path,samples,min_cyc,avg_cyc,max_cyc,min_ns,avg_ns,max_ns\n");
+    for (int p = 0; p < NUM_PATHS; p++) {
+        struct lat_stats *s = &stats[p];
+        uint64_t avg = s->samples ? s->sum / s->samples : 0;
+
+        printk("latency,%s,%u,%u,%u,%u,%u,%u,%u\n", s->name, s->samples, s->min,
+               (uint32_t)avg, s->max, cycles_to_ns(s->min), cycles_to_ns(avg),
+               cycles_to_ns(s->max));
+    }
+}
+
+// Runs all paths whenever run_sem is given, at boot and by the shell command
+static void bench(void *unused1, void *unused2, void *unused3)
+{
+    while (1) {
+        k_sem_take(&run_sem, K_FOREVER);
+        printk("kernel latency: %d iterations, cycle counter at %u Hz\n", iterations,
+               sys_clock_hw_cycles_per_sec());
+        stats_reset();
+        bench_sem_wakeup();
+        bench_status_sync();
+        bench_mutex_handoff();
+        bench_msgq();
+        print_stats();
+    }
+}
+
+K_THREAD_DEFINE(bench_tid, STACK_SIZE, bench, NULL, NULL, NULL, BENCH_PRIO, 0, 0);
+
+void main(void)
+{
+    k_thread_name_set(bench_tid, "bench");
+    k_thread_name_set(holder_tid, "holder");
+    k_sem_give(&run_sem);
+}
+
+static int latency_function(const struct shell *shell,
+                            size_t argc, char **argv)
+{
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            shell_error(shell, "iterations must be positive");
+            iterations = ITERATIONS;
+            return -EINVAL;
+        }
+    }
+    k_sem_give(&run_sem);
+    return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(latency, NULL, "Run the kernel latency benchmark [iterations]", latency_function, 1, 1);